@@ -14,6 +14,11 @@
 #include "MMC5.hpp"
 #include "VRC6.hpp"
 
+// Post-processing can work on several samples at a time using SIMD when available.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 // Global options.
 apu_options_t apu_options = {
    TRUE,                   // Enable processing
@@ -46,9 +51,18 @@ static void apu_repredict_irqs(const FLAGS predictionFlags);
 static force_inline void synchronize(void);
 static force_inline cpu_time_t process(const cpu_time_t time);
 static force_inline void mix(void);
-static force_inline void filter(real& sample, APULPFilter *lpEnv, APUDCFilter* dcEnv);
-static force_inline void amplify(real& sample);
-express_function void enqueue(real& sample);
+static force_inline void blip_mix(void);
+static force_inline void blip_add_delta(const int channel, const real delta);
+static force_inline real blip_read_sample(const int channel);
+static force_inline void subtract(real* samples, const int count, const real value);
+static force_inline void subtract_blend(real* samples, const int count, const real first, const real second,
+   const real weightPerStep, const real step);
+static force_inline void scale(real* samples, const int count, const real factor);
+static force_inline void scale_add(real* samples, const int count, const real factor);
+static void flush(void);
+static void filter(real* samples, const int frames, const int stride, APULPFilter* lpEnv, APUDCFilter* dcEnv);
+static void amplify(real* samples, const int count);
+express_function void enqueue(const int channel, const real sample);
 
 namespace {
 
@@ -100,6 +114,12 @@ enum {
 real square_table[31];
 real tnd_table[203];
 
+// Band-limited impulse kernels for each sub-sample phase, see blip_add_delta().
+real blip_kernels[APU_BLIP_PHASES][APU_BLIP_WIDTH];
+
+// Cutoff of the band-limited kernels, relative to the output sample rate's Nyquist frequency.
+const real apu_blip_cutoff = 0.9;
+
 // Maximum Triangle+Noise+DMC output of the mixer - for prenormalization.
 const real MAX_TND = 163.67 / (24329.0 / (3 * 15 + 2 * 15 + 127) + 100);
 
@@ -684,7 +704,15 @@ static discrete_function void apu_update_dmc(APUDMC& chan)
 
 static void apu_predict_dmc_irq(APUDMC& chan, const cpu_time_t cycles)
 {
-   // DMC IRQ predictor.  See apu_predict_frame_irq() for more information.
+   /* DMC IRQ predictor.  See apu_predict_frame_irq() for more information.
+
+      Rather than going through the motions cycle by cycle, this works out when the last byte of the
+      sample will be fetched, which is when the IRQ is raised.  If the sample buffer is empty, a byte
+      is fetched right away.  Every other byte is fetched on the cycle after an output cycle starts,
+      as that empties the sample buffer again.  An output cycle starts right away if the counter is
+      zero, and then on the cycle after each time the timer clocks the counter down to zero (every
+      8 clocks).  Only the first few timer clocks can be irregular (if the timer is zero or less), after
+      which the timer clocks once every period. */
 
    // Clear any pending interrupts just in case.
    cpu_clear_interrupt(CPU_INTERRUPT_IRQ_APU_DMC);
@@ -693,40 +721,48 @@ static void apu_predict_dmc_irq(APUDMC& chan, const cpu_time_t cycles)
    if(!chan.irq_gen || chan.looping)
       return;
 
-   // Save everything before processing.
-   const APUDMC saved_chan = chan;
+   // The IRQ is raised when the bytes counter becomes zero, so there must be bytes left to fetch.
+   if(chan.dma_length == 0)
+      return;
 
-   // Note that 'cycles' is the number of *APU* cycles to predict.
-   for(cpu_time_t current = 0; current < cycles; current++) {
-      // Just go through the motions...
-      if((chan.sample_bits == 0) && (chan.dma_length > 0)) {
-         chan.sample_bits = 8;
+   // Fetches that each have to wait for an output cycle to start.
+   cpu_rtime_t fetches = chan.dma_length;
+   if(chan.sample_bits == 0)
+      fetches--;
 
-         chan.dma_length--;
-         if(chan.dma_length == 0)
-            cpu_set_interrupt(CPU_INTERRUPT_IRQ_APU_DMC, apu.prediction_timestamp + (current * APU_CLOCK_MULTIPLIER));
-      }
+   // Note that all times here are in *APU* cycles, counting from the start of the prediction.
+   cpu_rtime_t time = 0;
 
-      if(chan.counter == 0) {
-         chan.counter = 8;
+   if(fetches > 0) {
+      // Timer clocks until the output cycle that the last fetch waits for starts.
+      const cpu_rtime_t clocks = chan.counter + ((fetches - 1) * 8);
 
-         if(chan.sample_bits > 0)
-            chan.sample_bits = 0;
-      }
+      cpu_rtime_t start = 0;
+      if(clocks > 0) {
+         const cpu_rtime_t period = Maximum<cpu_rtime_t>(chan.period, 1);
+         cpu_rtime_t timer = chan.timer;
 
-      if(chan.timer > 0) {
-         chan.timer--;
-         if(chan.timer > 0)
-            continue;
-      }
+         // While the timer is zero or less, it clocks on every cycle until it has been reloaded past zero.
+         cpu_rtime_t immediate = 0;
+         if(timer <= 0) {
+            immediate = (-timer / period) + 1;
+            timer += immediate * period;
+         }
 
-      chan.timer += chan.period;
+         cpu_rtime_t clock;
+         if(clocks <= immediate)
+            clock = clocks - 1;
+         else
+            clock = (immediate - 1) + timer + ((clocks - immediate - 1) * period);
 
-      chan.counter--;
+         start = clock + 1;
+      }
+
+      time = start + 1;
    }
 
-   // Restore everything from saved copy. 
-   chan = saved_chan;
+   if((cpu_time_t)time < cycles)
+      cpu_set_interrupt(CPU_INTERRUPT_IRQ_APU_DMC, apu.prediction_timestamp + (time * APU_CLOCK_MULTIPLIER));
 }
 
 static discrete_function void apu_save_dmc(const APUDMC& chan, FILE_CONTEXT* file, const int version)
@@ -800,14 +836,65 @@ static force_inline void apu_update_channels(const FLAGS updateFlags)
       apu_update_dmc(apu.dmc);
 }
 
-static force_inline void apu_reload_sequence_counter(void)
+// Returns how many cycles are left until a timer (e.g a channel's, or the frame sequencer's) clocks.
+static force_inline cpu_time_t apu_get_timer_distance(const int16 timer)
+{
+   // A timer that has already run out clocks on the very next cycle.
+   return (timer > 0) ? timer : 1;
+}
+
+/* Returns the number of cycles, up to 'limit', until the next cycle on which anything can change: a
+   channel's timer clocking, the frame sequencer clocking, the DMC needing attention, or an output
+   sample being due. Until then, every cycle would just decrement the timers, so all of those cycles can
+   be run at once by setting the timer delta to this value. */
+static force_inline cpu_time_t apu_get_next_event(const cpu_time_t limit)
+{
+   // ExSound sources are clocked along with the APU, but can't tell us when their outputs change.
+   if(apu_exsound_sourcer.getSources() > 0)
+      return 1;
+
+   cpu_time_t cycles = limit;
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(apu.square[0].timer));
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(apu.square[1].timer));
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(apu.triangle.timer));
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(apu.noise.timer));
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(apu.sequence_counter));
+
+   /* The DMC's memory reader and output unit act on the next cycle whenever the sample buffer is empty
+      with bytes left to fetch, or when an output cycle has ended. */
+   const APUDMC& dmc = apu.dmc;
+   if(((dmc.sample_bits == 0) && (dmc.dma_length > 0)) || (dmc.counter == 0))
+      return 1;
+
+   cycles = Minimum<cpu_time_t>(cycles, apu_get_timer_distance(dmc.timer));
+
+   if(audio_options.enable_output) {
+      // Stop on the cycle which completes the next output sample.
+      const real remaining = apu.mixer.max_samples - apu.mixer.accumulated_samples;
+      if(remaining <= 1.0)
+         return 1;
+
+      cycles = Minimum<cpu_time_t>(cycles, (cpu_time_t)ceil(remaining));
+   }
+
+   // Every distance above is at least one cycle, as is the limit.
+   return cycles;
+}
+
+// Returns the number of APU cycles until the step after 'step' of the frame sequencer.
+static force_inline int apu_get_sequence_period(const int step)
 {
    const int mode = (apu.sequence_steps == 5) ? 1 : 0;
 
    if(machine_type == MACHINE_TYPE_NTSC)
-      apu.sequence_counter += frame_sequencer_period_lut_ntsc[mode][apu.sequence_step - 1];
+      return frame_sequencer_period_lut_ntsc[mode][step - 1];
    else
-      apu.sequence_counter += frame_sequencer_period_lut_pal[mode][apu.sequence_step - 1];
+      return frame_sequencer_period_lut_pal[mode][step - 1];
+}
+
+static force_inline void apu_reload_sequence_counter(void)
+{
+   apu.sequence_counter += apu_get_sequence_period(apu.sequence_step);
 }
 
 static force_inline void apu_update_frame_sequencer(void)
@@ -911,9 +998,9 @@ static void apu_predict_frame_irq(const cpu_time_t cycles)
    /* This function predicts when the APU's frame IRQ will occur and queues
       it in the CPU core to trigger as close to that moment as possible.
 
-      We must be very careful to back up any variables we modify in this
-      function, since we don't want to affect the APU's actual state - only
-      get a rough(more accurate than not) idea of when the IRQ will occur. */
+      We must be very careful not to modify any of the APU's variables in
+      this function, since we don't want to affect the APU's actual state -
+      only get a rough(more accurate than not) idea of when the IRQ will occur. */
 
    // Clear any pending interrupts just in case.
    cpu_clear_interrupt(CPU_INTERRUPT_IRQ_APU_FRAME);
@@ -923,33 +1010,39 @@ static void apu_predict_frame_irq(const cpu_time_t cycles)
       (apu.sequence_steps == 5))
       return;
 
-   const int16 saved_sequence_counter = apu.sequence_counter;
-   const uint8 saved_sequence_step = apu.sequence_step;
-
-   /* Now we simply simulate emulating the frame sequencer cycle-by-cycle
-      (up to a minimum and maximum of 'cycles') keeping track of what
-      virtual cycle we are on for calls to cpu_set_interrupt(). */
-
-   // Note that cycles is the number of *APU* cycles to predict.
-   for(cpu_time_t current = 0; current < cycles; current++) {
-      if(apu.sequence_counter > 0) {
-         apu.sequence_counter--;
-         if(apu.sequence_counter > 0)
-            continue;
+   cpu_rtime_t counter = apu.sequence_counter;
+   int step = apu.sequence_step;
+
+   /* Now we simply step through the frame sequencer one step at a time,
+      rather than one cycle at a time, until we reach step 4 or run past
+      'cycles', keeping track of what virtual cycle each step is on for
+      the call to cpu_set_interrupt(). */
+
+   // Note that current is in *APU* cycles.
+   cpu_rtime_t current = 0;
+   while(true) {
+      // The counter is clocked once per cycle, and the step is taken when it reaches zero.
+      if(counter > 0) {
+         current += counter - 1;
+         counter = 0;
       }
 
-      apu_reload_sequence_counter();
+      if((cpu_time_t)current >= cycles)
+         return;
 
       // check to see if we should generate an irq
-      if(apu.sequence_step == 4)
+      if(step == 4) {
          cpu_set_interrupt(CPU_INTERRUPT_IRQ_APU_FRAME, apu.prediction_timestamp + (current * APU_CLOCK_MULTIPLIER));
+         return;
+      }
 
-      if(++apu.sequence_step > apu.sequence_steps)
-         apu.sequence_step = 1;
-   }
+      counter += apu_get_sequence_period(step);
 
-   apu.sequence_counter = saved_sequence_counter;
-   apu.sequence_step = saved_sequence_step;
+      if(++step > apu.sequence_steps)
+         step = 1;
+
+      current++;
+   }
 }
 
 void apu_load_config(void)
@@ -987,6 +1080,31 @@ void apu_load_config(void)
       square_table[n] = 95.52 / (8128.0 / n + 100);
    for(int n = 0; n < 203; n++)
       tnd_table[n] = 163.67 / (24329.0 / n + 100);
+
+   /* Build the band-limited impulse kernels. Each one is a Blackman-windowed sinc, offset by its
+      phase, and normalized so that its taps add up to exactly 1. This way an integrated step
+      always settles at exactly the new level. */
+   for(int phase = 0; phase < APU_BLIP_PHASES; phase++) {
+      const real offset = (real)phase / APU_BLIP_PHASES;
+      const real center = (APU_BLIP_WIDTH - 1) / 2.0;
+
+      real sum = 0.0;
+      for(int tap = 0; tap < APU_BLIP_WIDTH; tap++) {
+         const real x = (tap - offset) - center;
+
+         const real angle = M_PI * apu_blip_cutoff * x;
+         const real sinc = (fabs(angle) < Epsilon) ? 1.0 : (sin(angle) / angle);
+
+         const real position = Clamp<real>(x / (APU_BLIP_WIDTH / 2.0), -1.0, 1.0);
+         const real window = 0.42 + (0.5 * cos(M_PI * position)) + (0.08 * cos(2.0 * M_PI * position));
+
+         blip_kernels[phase][tap] = sinc * window;
+         sum += blip_kernels[phase][tap];
+      }
+
+      for(int tap = 0; tap < APU_BLIP_WIDTH; tap++)
+         blip_kernels[phase][tap] /= sum;
+   }
 }
 
 void apu_save_config(void)
@@ -1014,6 +1132,13 @@ void apu_save_config(void)
 
 int apu_init(void)
 {
+   /* Each machine context has its own APU. The ExSound interfaces are copied as they are,
+      which is safe because their types (and thus their virtual tables) never change. */
+   MACHINE_REGISTER_STATE(apu);
+   MACHINE_REGISTER_STATE(apu_exsound_sourcer);
+   MACHINE_REGISTER_STATE(apu_exsound_mmc5);
+   MACHINE_REGISTER_STATE(apu_exsound_vrc6);
+
    // Begin initialization sequence.
    apu.initializing = 1;
 
@@ -1592,7 +1717,9 @@ void apu_sync_update(void)
    // Sync state.
    synchronize();
 
+   BENCHMARK_ENTER(BENCHMARK_SECTION_APU);
    audio_update();
+   BENCHMARK_LEAVE();
 }
 
 void apu_load_state(FILE_CONTEXT* file, const int version)
@@ -1705,7 +1832,9 @@ static force_inline void synchronize(void)
    apu.synchronizing = true;
 
    // Process individual clock cycles until we are caught up.
+   BENCHMARK_ENTER(BENCHMARK_SECTION_APU);
    process(time);
+   BENCHMARK_LEAVE();
 
    // End unbreakable code section.
    apu.synchronizing = false;
@@ -1761,10 +1890,8 @@ static force_inline cpu_time_t process(const cpu_time_t time)
                      // Fetch sample.
                      real sample = apu.mixer.inputs[channel];
 
-                     // Send it to the audio queue.
-                     filter(sample, &apu.mixer.lpEnv[channel], &apu.mixer.dcEnv[channel]);
-                     amplify(sample);
-                     enqueue(sample);
+                     // Send it on for post-processing.
+                     enqueue(channel, sample);
                   }
                }
 
@@ -1777,10 +1904,11 @@ static force_inline cpu_time_t process(const cpu_time_t time)
       }
 
       case APU_EMULATION_ACCURATE: {
-         // Since we'll be emulating every cycle, we'll use a timer delta of 1.
-         apu.timer_delta = 1;
+         /* Rather than emulating every cycle, we skip straight from one cycle on which something can
+            happen to the next, using the number of cycles skipped as the timer delta. */
+         for(cpu_time_t current = 0; current < cycles; current += apu.timer_delta) {
+            apu.timer_delta = apu_get_next_event(cycles - current);
 
-         for(cpu_time_t current = 0; current < cycles; current++) {
             // Update the frame sequencer.
             apu_update_frame_sequencer();
             // ~1.79MHz update driven independantly of the frame sequencer.
@@ -1791,7 +1919,7 @@ static force_inline cpu_time_t process(const cpu_time_t time)
 
             if(audio_options.enable_output) {
                // Simulate accumulation.
-               apu.mixer.accumulated_samples++;
+               apu.mixer.accumulated_samples += apu.timer_delta;
                if(apu.mixer.accumulated_samples >= apu.mixer.max_samples) {
                   // Mix outputs together.
                   mix();
@@ -1801,10 +1929,8 @@ static force_inline cpu_time_t process(const cpu_time_t time)
                      // Fetch sample.
                      real sample = apu.mixer.inputs[channel];
 
-                     // Send it to the audio queue.
-                     filter(sample, &apu.mixer.lpEnv[channel], &apu.mixer.dcEnv[channel]);
-                     amplify(sample);
-                     enqueue(sample);
+                     // Send it on for post-processing.
+                     enqueue(channel, sample);
                   }
 
                   // Adjust counter.
@@ -1817,10 +1943,29 @@ static force_inline cpu_time_t process(const cpu_time_t time)
       }
 
       case APU_EMULATION_HIGH_QUALITY: {
-         // Since we'll be emulating every cycle, we'll use a timer delta of 1.
-         apu.timer_delta = 1;
+         // As with the accurate mode, we only stop on cycles where something can happen.
+         for(cpu_time_t current = 0; current < cycles; current += apu.timer_delta) {
+            apu.timer_delta = apu_get_next_event(cycles - current);
+
+            if(audio_options.enable_output && (apu.timer_delta > 1)) {
+               /* The outputs can't change until the last of the skipped cycles, so every cycle before
+                  that one mixes to the same samples as the last cycle did. */
+               if(current == 0) {
+                  /* Register writes since the last call may have changed the outputs directly, so
+                     the last cycle's samples can't be reused for the first span. */
+                  mix();
+
+                  for(int channel = 0; channel < apu.mixer.channels; channel++)
+                     apu.mixer.sample_cache[channel] = apu.mixer.inputs[channel];
+               }
+
+               const cpu_time_t skipped = apu.timer_delta - 1;
+               for(int channel = 0; channel < apu.mixer.channels; channel++)
+                  apu.mixer.accumulators[channel] += apu.mixer.sample_cache[channel] * skipped;
+
+               apu.mixer.accumulated_samples += skipped;
+            }
 
-         for(cpu_time_t current = 0; current < cycles; current++) {
             // Update the frame sequencer.
             apu_update_frame_sequencer();
             // Update outputs.
@@ -1857,10 +2002,8 @@ static force_inline cpu_time_t process(const cpu_time_t time)
                      // Divide.
                      sample /= divider;
 
-                     // Send it to the audio queue.
-                     filter(sample, null, &apu.mixer.dcEnv[channel]);
-                     amplify(sample);
-                     enqueue(sample);
+                     // Send it on for post-processing.
+                     enqueue(channel, sample);
                   }
 
                   // Reload accumulators with residual sample portion.
@@ -1876,10 +2019,65 @@ static force_inline cpu_time_t process(const cpu_time_t time)
          break;
       }
 
+      case APU_EMULATION_BAND_LIMITED: {
+         /* Band-limited step synthesis. The channels are clocked as in the other accurate modes, but
+            rather than mixing on every cycle, we only mix when an output has changed, and add the
+            change in level to the band-limited step buffer at the exact point where it happened.
+            The buffer is then read once per output sample. This sounds like the High Quality mode,
+            without having to mix and accumulate every cycle. As with the other accurate modes, we
+            only stop on cycles where something can happen. */
+         for(cpu_time_t current = 0; current < cycles; current += apu.timer_delta) {
+            apu.timer_delta = apu_get_next_event(cycles - current);
+
+            if(audio_options.enable_output && (apu.timer_delta > 1)) {
+               /* Register writes since the last call may have changed the outputs directly, which
+                  has to be picked up on the first cycle rather than at the end of the span. */
+               if(current == 0)
+                  blip_mix();
+
+               // The skipped cycles only move us along within the current output sample.
+               apu.mixer.accumulated_samples += apu.timer_delta - 1;
+            }
+
+            // Update the frame sequencer.
+            apu_update_frame_sequencer();
+            // Update outputs.
+            apu_update_channels(UPDATE_OUTPUT);
+
+            // Update ExSound.
+            apu_exsound_sourcer.process(apu.timer_delta);
+
+            if(audio_options.enable_output) {
+               // Add any change in the outputs to the step buffer.
+               blip_mix();
+
+               apu.mixer.accumulated_samples++;
+               if(apu.mixer.accumulated_samples >= apu.mixer.max_samples) {
+                  for(int channel = 0; channel < apu.mixer.channels; channel++) {
+                     real sample = blip_read_sample(channel);
+
+                     // Send it on for post-processing.
+                     enqueue(channel, sample);
+                  }
+
+                  apu.mixer.blip_position = (apu.mixer.blip_position + 1) & (APU_BLIP_BUFFER_SIZE - 1);
+
+                  // Adjust counter.
+                  apu.mixer.accumulated_samples -= apu.mixer.max_samples;
+               }
+            }
+         }
+
+         break;
+      }
+
       default:
          WARN_GENERIC();
    }
 
+   // Send off whatever is left of the current block, so that nothing is held back until the next call.
+   flush();
+
    // Return the number of cycles processed.
    return cycles * APU_CLOCK_MULTIPLIER;
 }
@@ -1971,47 +2169,245 @@ static force_inline void mix(void)
    }
 }
 
-static force_inline void filter(real& sample, APULPFilter* lpEnv, APUDCFilter* dcEnv)
+static force_inline void blip_mix(void)
+{
+   /* Detect output changes by packing all of the outputs together. ExSound sources don't
+      expose theirs, so with those present we have to mix every cycle. */
+   const uint32 outputs = apu.square[0].output | (apu.square[1].output << 4) |
+      (apu.triangle.output << 8) | (apu.noise.output << 12) | (apu.dmc.output << 16);
+
+   if((outputs == apu.mixer.blip_outputs) && (apu_exsound_sourcer.getSources() == 0))
+      return;
+
+   apu.mixer.blip_outputs = outputs;
+
+   // Mix outputs together.
+   mix();
+
+   for(int channel = 0; channel < apu.mixer.channels; channel++) {
+      const real delta = apu.mixer.inputs[channel] - apu.mixer.blip_levels[channel];
+      if(delta != 0.0) {
+         blip_add_delta(channel, delta);
+         apu.mixer.blip_levels[channel] = apu.mixer.inputs[channel];
+      }
+   }
+}
+
+static force_inline void blip_add_delta(const int channel, const real delta)
+{
+   /* Adds a change in level to the band-limited step buffer, at the current position within the
+      output sample being built. The change is spread over the following samples as a band-limited
+      impulse, which becomes a band-limited step once integrated by blip_read_sample(). */
+   const int phase = (int)((apu.mixer.accumulated_samples / apu.mixer.max_samples) * APU_BLIP_PHASES);
+   const real* kernel = blip_kernels[Clamp<int>(phase, 0, APU_BLIP_PHASES - 1)];
+
+   real* buffer = apu.mixer.blip_buffer[channel];
+   const int position = apu.mixer.blip_position;
+
+   for(int tap = 0; tap < APU_BLIP_WIDTH; tap++)
+      buffer[(position + tap) & (APU_BLIP_BUFFER_SIZE - 1)] += delta * kernel[tap];
+}
+
+static force_inline real blip_read_sample(const int channel)
+{
+   /* Reads the output sample that has just been completed. Changes that happen from now on can only
+      affect later samples, so its slot is cleared for reuse. */
+   real& slot = apu.mixer.blip_buffer[channel][apu.mixer.blip_position];
+
+   apu.mixer.blip_integrators[channel] += slot;
+   slot = 0.0;
+
+   return apu.mixer.blip_integrators[channel];
+}
+
+/* These run the simple stages of post-processing over contiguous samples, several at a time when SIMD is available. Each
+   sample goes through exactly the same operations in the same order either way, so the output does not change. Whatever
+   is left over at the end of a run is done by the scalar loop, which is also used when SIMD isn't available. Only AVX2
+   versions are provided, as working on two samples at a time with SSE was no faster than the scalar loops. */
+static force_inline void subtract(real* samples, const int count, const real value)
+{
+   int i = 0;
+
+#if defined(__AVX2__)
+   const __m256d values = _mm256_set1_pd(value);
+   for(; (i + 4) <= count; i += 4)
+      _mm256_storeu_pd(&samples[i], _mm256_sub_pd(_mm256_loadu_pd(&samples[i]), values));
+#endif
+
+   for(; i < count; i++)
+      samples[i] -= value;
+}
+
+// Subtracts a blend of two values, whose weight increases by 'weightPerStep' with each sample, starting from 'step'.
+static force_inline void subtract_blend(real* samples, const int count, const real first, const real second,
+   const real weightPerStep, const real step)
+{
+   int i = 0;
+
+#if defined(__AVX2__)
+   const __m256d firsts = _mm256_set1_pd(first);
+   const __m256d seconds = _mm256_set1_pd(second);
+   const __m256d weights = _mm256_set1_pd(weightPerStep);
+   const __m256d steps = _mm256_set1_pd(step);
+   const __m256d ones = _mm256_set1_pd(1.0);
+   const __m256d offsets = _mm256_set_pd(3.0, 2.0, 1.0, 0.0);
+
+   for(; (i + 4) <= count; i += 4) {
+      // The indices are rebuilt from 'i' each time, so that the iterations don't depend on one another.
+      const __m256d indices = _mm256_add_pd(_mm256_set1_pd(i), offsets);
+      const __m256d weight = _mm256_mul_pd(weights, _mm256_add_pd(steps, indices));
+      const __m256d blend = _mm256_add_pd(_mm256_mul_pd(firsts, _mm256_sub_pd(ones, weight)),
+                                          _mm256_mul_pd(seconds, weight));
+      _mm256_storeu_pd(&samples[i], _mm256_sub_pd(_mm256_loadu_pd(&samples[i]), blend));
+   }
+#endif
+
+   for(; i < count; i++) {
+      const real weight = weightPerStep * (step + i);
+      samples[i] -= (first * (1.0 - weight)) + (second * weight);
+   }
+}
+
+static force_inline void scale(real* samples, const int count, const real factor)
+{
+   int i = 0;
+
+#if defined(__AVX2__)
+   const __m256d factors = _mm256_set1_pd(factor);
+   for(; (i + 4) <= count; i += 4)
+      _mm256_storeu_pd(&samples[i], _mm256_mul_pd(_mm256_loadu_pd(&samples[i]), factors));
+#endif
+
+   for(; i < count; i++)
+      samples[i] *= factor;
+}
+
+// Adds each sample scaled by 'factor' back onto itself.
+static force_inline void scale_add(real* samples, const int count, const real factor)
+{
+   int i = 0;
+
+#if defined(__AVX2__)
+   const __m256d factors = _mm256_set1_pd(factor);
+   for(; (i + 4) <= count; i += 4) {
+      const __m256d input = _mm256_loadu_pd(&samples[i]);
+      _mm256_storeu_pd(&samples[i], _mm256_add_pd(input, _mm256_mul_pd(input, factors)));
+   }
+#endif
+
+   for(; i < count; i++)
+      samples[i] += samples[i] * factor;
+}
+
+static void flush(void)
 {
+   /* Post-processes the samples collected by enqueue() and sends them to the audio queue. Working on a block at a time
+      lets each stage run as a tight loop, rather than doing all of them for every sample. */
+   const int frames = apu.mixer.block_frames;
+   if(frames == 0)
+      return;
+
+   apu.mixer.block_frames = 0;
+
+   /* The low pass filter is not needed in High Quality or Band-Limited mode, since it is already implied by the mixing
+      method. */
+   const bool lowPass = (apu_options.emulation == APU_EMULATION_FAST) ||
+                        (apu_options.emulation == APU_EMULATION_ACCURATE);
+
+   const int channels = apu.mixer.channels;
+   for(int channel = 0; channel < channels; channel++) {
+      filter(&apu.mixer.block[channel], frames, channels,
+         lowPass ? &apu.mixer.lpEnv[channel] : null, &apu.mixer.dcEnv[channel]);
+   }
+
+   const int count = frames * channels;
+   amplify(apu.mixer.block, count);
+
+   audio_queue_samples(apu.mixer.block, count);
+}
+
+static void filter(real* samples, const int frames, const int stride, APULPFilter* lpEnv, APUDCFilter* dcEnv)
+{
+   // Filters one channel of a block, whose samples are 'stride' apart.
    if(lpEnv) {
       // Low pass filter.
-      sample = (sample * apu_lpf_input_weight) + (lpEnv->filter_sample * apu_lpf_previous_weight);
-      lpEnv->filter_sample = sample;
+      real previous = lpEnv->filter_sample;
+      for(int i = 0; i < frames; i++) {
+         real& sample = samples[i * stride];
+         sample = (sample * apu_lpf_input_weight) + (previous * apu_lpf_previous_weight);
+         previous = sample;
+      }
+
+      lpEnv->filter_sample = previous;
    }
 
    if(dcEnv) {
-      // DC blocking filter.
-      const real saved_sample = sample;
-
-      // Apply filter.
-      if(dcEnv->stepTime > 0.0) {
-         const real weight = dcEnv->weightPerStep * dcEnv->curStep;
-         sample -= (dcEnv->filter_sample * (1.0 - weight)) + (dcEnv->next_filter_sample * weight);
-         dcEnv->curStep++;
-      }
-      else
-         sample -= dcEnv->filter_sample;
+      /* DC blocking filter. The filtering parameters only change when a step ends or the timer runs out, so the block is
+         filtered in runs between those points, each of which is a simple loop. */
+      int frame = 0;
+      while(frame < frames) {
+         const bool stepping = dcEnv->stepTime > 0.0;
+
+         // Find out how many samples we can do before something changes, including the one where it does.
+         int run = frames - frame;
+         if(stepping)
+            run = Minimum<int>(run, (int)ceil(dcEnv->stepTime));
+         if(dcEnv->timer > 0.0)
+            run = Minimum<int>(run, (int)ceil(dcEnv->timer));
+         else
+            run = 1;
+
+         real* input = &samples[frame * stride];
+         // Unfiltered value of the last sample in the run, for when the timer runs out.
+         const real saved_sample = input[(run - 1) * stride];
+
+         /* Apply filter. Mono samples are contiguous, so they can go through the SIMD versions, while stereo samples
+            are interleaved and have to be done one at a time. */
+         if(stepping) {
+            if(stride == 1)
+               subtract_blend(input, run, dcEnv->filter_sample, dcEnv->next_filter_sample,
+                  dcEnv->weightPerStep, dcEnv->curStep);
+            else {
+               for(int i = 0; i < run; i++) {
+                  const real weight = dcEnv->weightPerStep * (dcEnv->curStep + i);
+                  input[i * stride] -= (dcEnv->filter_sample * (1.0 - weight)) + (dcEnv->next_filter_sample * weight);
+               }
+            }
 
-      // Update filtering parameters.
-      if(dcEnv->stepTime > 0.0) {
-         dcEnv->stepTime--;
-         if(dcEnv->stepTime <= 0.0)
-            dcEnv->filter_sample = dcEnv->next_filter_sample;
-      }
+            dcEnv->curStep += run;
+         }
+         else {
+            if(stride == 1)
+               subtract(input, run, dcEnv->filter_sample);
+            else {
+               for(int i = 0; i < run; i++)
+                  input[i * stride] -= dcEnv->filter_sample;
+            }
+         }
 
-      if(dcEnv->timer > 0.0)
-         dcEnv->timer--;
-      if(dcEnv->timer <= 0.0) {
-         dcEnv->timer += audio_sample_rate / apu_dcf_frequency;
-         dcEnv->next_filter_sample = saved_sample;
-         dcEnv->stepTime = audio_sample_rate * apu_dcf_step_time;
-         dcEnv->weightPerStep = 1.0 / dcEnv->stepTime;
-         dcEnv->curStep = 0.0;
+         // Update filtering parameters.
+         if(stepping) {
+            dcEnv->stepTime -= run;
+            if(dcEnv->stepTime <= 0.0)
+               dcEnv->filter_sample = dcEnv->next_filter_sample;
+         }
+
+         if(dcEnv->timer > 0.0)
+            dcEnv->timer -= run;
+         if(dcEnv->timer <= 0.0) {
+            dcEnv->timer += audio_sample_rate / apu_dcf_frequency;
+            dcEnv->next_filter_sample = saved_sample;
+            dcEnv->stepTime = audio_sample_rate * apu_dcf_step_time;
+            dcEnv->weightPerStep = 1.0 / dcEnv->stepTime;
+            dcEnv->curStep = 0.0;
+         }
+
+         frame += run;
       }
    }
 }
 
-static force_inline void amplify(real& sample)
+static void amplify(real* samples, const int count)
 {
    /* Volume level normalizer. Note that this is not a true normalizer, as they are impossible to
       make in real time, due to operating only on a whole waveform at once. This filter simply
@@ -2019,55 +2415,77 @@ static force_inline void amplify(real& sample)
    if(apu_options.normalize) {
       static uint8 buffer[apu_vln_samples_buffer];
       static real accumulator = 0.0;
-      static int count;
+      static int accumulated;
       static real output = 0.0;
 
-      accumulator += fabs(sample);
-      count++;
-      if(count >= apu_vln_samples_accumulate) {
-         for(unsigned i = 0; i < (apu_vln_samples_buffer - 1); i++)
-            buffer[i] = buffer[i + 1];
+      int offset = 0;
+      while(offset < count) {
+         // The output level only changes once every so many samples, so work through them in runs of that length.
+         const int run = Minimum<int>(count - offset, apu_vln_samples_accumulate - accumulated);
+         real* input = &samples[offset];
 
-         const int level = (accumulator / count) * 128;
-         buffer[apu_vln_samples_buffer - 1] = Clamp<int>(level, 0, 255);
-         accumulator = 0.0;
-         count = 0;
+         for(int i = 0; i < run; i++)
+            accumulator += fabs(input[i]);
 
-         real average = 0.0;
-         for(unsigned i = 0; i < (unsigned)apu_vln_samples_buffer; i++)
-            average += buffer[i];
+         accumulated += run;
 
-         average /= apu_vln_samples_buffer;
-         average /= 128;
-         output = 1.0 - (average / apu_vln_average_weight);
-      }
+         // The last sample of a run that fills up the accumulator is already affected by the new level.
+         const bool update = accumulated >= apu_vln_samples_accumulate;
+         const int unaffected = update ? (run - 1) : run;
+
+         scale_add(input, unaffected, output);
+
+         if(update) {
+            for(unsigned i = 0; i < (apu_vln_samples_buffer - 1); i++)
+               buffer[i] = buffer[i + 1];
+
+            const int level = (accumulator / accumulated) * 128;
+            buffer[apu_vln_samples_buffer - 1] = Clamp<int>(level, 0, 255);
+            accumulator = 0.0;
+            accumulated = 0;
+
+            real average = 0.0;
+            for(unsigned i = 0; i < (unsigned)apu_vln_samples_buffer; i++)
+               average += buffer[i];
 
-      sample += sample * output;
+            average /= apu_vln_samples_buffer;
+            average /= 128;
+            output = 1.0 - (average / apu_vln_average_weight);
+
+            input[unaffected] += input[unaffected] * output;
+         }
+
+         offset += run;
+      }
    }
 
    if(apu_options.agc) {
       // Automatic gain control.
       static real gain = 0.0;
 
-      const real amplitude = fabs(sample);
-      if(amplitude > gain) {
-         const real attackTime = audio_sample_rate * apu_agc_attack_time;
-         const real attackRate = 1.0 / attackTime;
-         gain += attackRate;
-      }
-      else if(amplitude < gain) {
-         const real releaseTime = audio_sample_rate * apu_agc_release_time;
-         const real releaseRate = 1.0 / releaseTime;
-         gain -= releaseRate;
-      }
+      const real attackTime = audio_sample_rate * apu_agc_attack_time;
+      const real attackRate = 1.0 / attackTime;
+      const real releaseTime = audio_sample_rate * apu_agc_release_time;
+      const real releaseRate = 1.0 / releaseTime;
+
+      // The gain depends on every sample before it, so this has to be done one sample at a time.
+      for(int i = 0; i < count; i++) {
+         real& sample = samples[i];
+
+         const real amplitude = fabs(sample);
+         if(amplitude > gain)
+            gain += attackRate;
+         else if(amplitude < gain)
+            gain -= releaseRate;
 
-      real output = 1.0 / Maximum<real>(gain, Epsilon);
-      output = Clamp<real>(output, apu_agc_gain_floor, apu_agc_gain_ceiling);
-      sample *= output;
+         real output = 1.0 / Maximum<real>(gain, Epsilon);
+         output = Clamp<real>(output, apu_agc_gain_floor, apu_agc_gain_ceiling);
+         sample *= output;
+      }
    }
 
    // Apply global volume
-   sample *= apu_options.volume;
+   scale(samples, count, apu_options.volume);
 
    if(apu_options.logarithmic) {
       const unsigned size = 16384; // 16384*sizeof(float)=65536
@@ -2082,19 +2500,33 @@ static force_inline void amplify(real& sample)
          initialized = true;
       }
 
-      const unsigned index = Clamp<int>( Round<real>(fabs(sample) * maximum), 0, maximum );
-      if(sample < 0.0)
-         sample = 0.0 - log_lut[index];
-      else
-         sample = log_lut[index];
+      for(int i = 0; i < count; i++) {
+         real& sample = samples[i];
+
+         const unsigned index = Clamp<int>( Round<real>(fabs(sample) * maximum), 0, maximum );
+         if(sample < 0.0)
+            sample = 0.0 - log_lut[index];
+         else
+            sample = log_lut[index];
+      }
    }
 
    // Apply squelch
-   if(apu_options.squelch)
-      sample = 0;
+   if(apu_options.squelch) {
+      for(int i = 0; i < count; i++)
+         samples[i] = 0;
+   }
 }
 
-express_function void enqueue(real& sample)
+express_function void enqueue(const int channel, const real sample)
 {
-   audio_queue_sample(sample);
+   // Collect the sample into the current block, which is post-processed by flush() once it fills up.
+   apu.mixer.block[(apu.mixer.block_frames * apu.mixer.channels) + channel] = sample;
+
+   if(channel == (apu.mixer.channels - 1)) {
+      // That completes the frame.
+      apu.mixer.block_frames++;
+      if(apu.mixer.block_frames >= APU_MIXER_BLOCK_FRAMES)
+         flush();
+   }
 }
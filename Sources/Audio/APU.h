@@ -18,7 +18,8 @@ extern "C" {
 enum {
    APU_EMULATION_FAST = 0,
    APU_EMULATION_ACCURATE,
-   APU_EMULATION_HIGH_QUALITY
+   APU_EMULATION_HIGH_QUALITY,
+   APU_EMULATION_BAND_LIMITED
 };
 
 enum {
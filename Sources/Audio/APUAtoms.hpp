@@ -12,6 +12,16 @@
 // Maximum number of channels to send to the DSP (mono = 1, stereo = 2).
 static const enum_type APU_MIXER_MAX_CHANNELS = 2;
 
+/* Band-limited step synthesis. Each change in output level is added to a small ring buffer as a
+   band-limited impulse, taken from a table of kernels with this many taps, at one of this many
+   sub-sample phases. Output samples are then produced by integrating the buffer. */
+static const int APU_BLIP_WIDTH = 16;
+static const int APU_BLIP_PHASES = 32;
+static const int APU_BLIP_BUFFER_SIZE = 32; // Must be a power of two, larger than APU_BLIP_WIDTH.
+
+// Number of frames the mixer collects before filtering and amplifying them and sending them to the audio queue.
+static const int APU_MIXER_BLOCK_FRAMES = 256;
+
 class APUEnvelope {
 public:
    uint8 timer;
@@ -171,6 +181,17 @@ public:
       APULPFilter lpEnv[APU_MIXER_MAX_CHANNELS];
       APUDCFilter dcEnv[APU_MIXER_MAX_CHANNELS];
 
+      // Band-limited synthesis.
+      uint32 blip_outputs;                // Channel outputs at the last mix, packed.
+      real blip_levels[APU_MIXER_MAX_CHANNELS];
+      real blip_buffer[APU_MIXER_MAX_CHANNELS][APU_BLIP_BUFFER_SIZE];
+      real blip_integrators[APU_MIXER_MAX_CHANNELS];
+      int blip_position;
+
+      // Samples waiting to be post-processed, with the channels interleaved.
+      real block[APU_MIXER_BLOCK_FRAMES * APU_MIXER_MAX_CHANNELS];
+      int block_frames;
+
    } mixer;
 };
 
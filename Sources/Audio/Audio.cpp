@@ -8,7 +8,16 @@
 #include "APU.h"
 #include "Audio.h"
 #include "AudioLib.hpp"
+#include "Internals.h"
 #include "Local.hpp"
+#include "Platform/Threads.h"
+
+// Samples can be converted to the subsystem's format using SIMD when available.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
 
 /* TODO: Fix WAV recording stuff up to work properly on big-endian platforms(currently it produces a big-endian ordered
          WAV file, I think). */
@@ -58,19 +67,62 @@ unsigned audio_buffer_size_bytes = 0;   // numframes*numchannels*(bitspersample/
    Samples in the queue should be stored in unsigned 16-bit format.  Any pre-processing such as stereo blending must be done
    prior to storing the samples to the queue, as it won't be done automatically.
 
-   Use audio_queue_sample() (defined in audio.h) to write to the queue in a performance-efficient way.  However, since the
-   queue is stored as a vector, that function will only work from C++ code. */
-std::vector<uint16> audioQueue;
+   Use audio_queue_samples() (defined in Internals.h) to write blocks of samples to the queue in a performance-efficient
+   way.  However, that function will only work from C++ code.
 
-// Audio buffer, for transfering samples from the queue to the active subsystem in the appropriate format.
-static void* audioBuffer = null;
+   The queue is a fixed-size single-producer/single-consumer ring buffer, so the writer (the APU) and the reader
+   (audio_update() or the audio thread) never have to wait on each other, and samples never have to be moved around once
+   they have been queued - they are converted straight into the subsystem's buffer.  The writer's position is published by
+   audio_update() and the reader's after it takes samples out.  When the queue is full, the APU drops whole frames rather
+   than overwriting ones that haven't been read yet. */
+AudioQueue audioQueue = { null, 0, 0, 0, 0, 0, 0 };
+
+// How many audio buffers' worth of samples the queue can hold.
+static const unsigned audioQueueBuffers = 8;
 
-// The number of frames currently present in the audio buffer.
-static unsigned audioBufferedFrames = 0;
+// Number of samples converted to the subsystem's format at a time, when they don't come straight from the queue.
+static const unsigned audioBlockSamples = 256;
+
+/* Audio buffer, for transfering samples from the queue to subsystems which don't have a buffer of their own, in the
+   appropriate format. */
+static void* audioBuffer = null;
 
 // Frame rate counter.
 volatile int audio_fps = 0;
 
+/* Counters for monitoring.  Overruns are frames lost because the queue was full or the subsystem couldn't keep up, and
+   underruns are frames of silence the subsystem was given because the queue ran dry.  These only ever count up. */
+volatile int audio_overruns = 0;
+volatile int audio_underruns = 0;
+
+// Buffer length to use when none is forced.  Read-only outside of the audio system.
+int audio_default_buffer_length_ms = 75;
+
+/* Audio thread, which feeds the subsystem as soon as it has room for more, rather than whenever the emulation gets around
+   to calling audio_update().  Since the subsystem no longer has to ride out the emulation's timing, a much shorter buffer
+   (and so less latency) will do.  The lock is held while the subsystem is being fed, and by the emulation thread
+   whenever it touches the subsystem or anything the feeding depends on (the WAV writer and the visualization buffer). */
+static THREAD* audioThread = null;
+static THREAD_LOCK* audioLock = null;
+static bool audioSuspended = false;
+static bool audioPrimed = false;
+
+// How often (in milliseconds) the audio thread checks whether the subsystem has room for more.
+static const int audioThreadTimeout = 2;
+
+/* Dynamic rate control for the audio thread.  The emulated and real clocks never quite agree (the NES runs at 60.0988 Hz,
+   and sound cards drift), which would slowly drain or overfill the queue.  So the queue is read very slightly faster or
+   slower than normal to keep it at its target fill level: at most 'audioRateRange' (0.5%) either way, which can't be
+   heard.  The full range is used once the queue is a quarter of the target away from it, so that even at the limit there
+   is always enough in the queue.  The fill level is smoothed since the emulation writes to the queue in bursts of a
+   frame at a time. */
+static const real audioRateRange = 0.005;
+static const real audioRateGain = 4.0;
+static const real audioRateSmoothing = 0.125;
+static unsigned audioQueueTarget = 0;
+static real audioQueueFill = 0.0;
+static real audioResamplePosition = 0.0;
+
 // Variables for the WAV writer(see bottom).
 static FILE_CONTEXT* wavFile = null;
 static unsigned wavSize = 0;
@@ -83,6 +135,19 @@ static unsigned audioVisBufferOffset = 0;
 static unsigned audioVisBufferHead = 0;
 static unsigned audioVisBufferTail = 0;
 
+static void audio_queue_reset(void);
+static unsigned audio_queue_get_frames(void);
+static void audio_queue_skip(const unsigned frames);
+static void audio_queue_read(void* buffer, const unsigned frames);
+static void audio_queue_resample(void* buffer, const unsigned frames, const real step);
+static void audio_output_block(void* buffer, const unsigned offset, const uint16* samples, const unsigned count);
+
+static bool audio_can_thread(void);
+static void audio_start_thread(void);
+static void audio_stop_thread(void);
+static void audio_thread(THREAD* thread, void* data);
+static bool audio_feed(void);
+
 void audio_load_config(void)
 {
    DEBUG_PRINTF("audio_load_config()\n");
@@ -115,6 +180,9 @@ int audio_init(void)
    // Determine number of channels.
    audio_channels = apu_options.stereo ? 2 : 1;
 
+   // Fed from the audio thread, the subsystem gets by with a much shorter buffer.
+   audio_default_buffer_length_ms = audio_can_thread() ? 30 : 75;
+
    // Initialize audio library.
    int result = audiolib_init();
    if(result != 0) {
@@ -149,6 +217,22 @@ int audio_init(void)
    // Clear buffer.
    memset(audioBuffer, 0, audio_buffer_size_bytes);
 
+   // Allocate queue.
+   unsigned queueSize = 1;
+   while(queueSize < (audio_buffer_size_samples * audioQueueBuffers))
+      queueSize <<= 1;
+
+   audio_queue_reset();
+   audioQueue.samples = (uint16*)malloc(queueSize * sizeof(uint16));
+   if(!audioQueue.samples) {
+      WARN("Couldn't allocate audio queue (out of memory?)");
+      audio_exit();
+      return 1;
+   }
+
+   audioQueue.size = queueSize;
+   audioQueue.mask = queueSize - 1;
+
    // Begin playing.
    result = audiolib_open_stream();
    if(result != 0) {
@@ -157,6 +241,9 @@ int audio_init(void)
       return 16 + result;
    }
 
+   // Feed the subsystem from a separate thread if we can.
+   audio_start_thread();
+
    // Return success.
    return 0;
 }
@@ -165,6 +252,9 @@ void audio_exit(void)
 {
    DEBUG_PRINTF("audio_exit()\n");
 
+   // The audio thread has to be gone before the subsystem is.
+   audio_stop_thread();
+
    // Deinitialize audio library.
    audiolib_exit();
 
@@ -172,15 +262,17 @@ void audio_exit(void)
       // Destroy audio buffer.
       free(audioBuffer);
       audioBuffer = null;
-      // Clear the frame counter.
-      audioBufferedFrames = 0;
    }
 
-   if(audioQueue.size() > 0) {
-      // Clear queue.
-      audioQueue.clear();
+   if(audioQueue.samples) {
+      // Destroy queue.
+      free(audioQueue.samples);
+      audioQueue.samples = null;
    }
 
+   // Empty the queue, leaving it with no room so that anything the APU writes to it is dropped.
+   audio_queue_reset();
+
    if(wavFile)
       audio_close_wav();
 
@@ -196,199 +288,427 @@ void audio_update(void)
    if(!audio_options.enable_output)
       return;
 
-   // Check if the buffer is full.
-   if(audioBufferedFrames == audio_buffer_size_frames) {
-      // See if we can update the driver buffer yet.
-      void* audiolibBuffer = audiolib_get_buffer(audioBuffer);
-      if(audiolibBuffer) {
-         if(audiolibBuffer != audioBuffer) {
-            // Copy to external buffer.
-            memcpy(audiolibBuffer, audioBuffer, audio_buffer_size_bytes);
-         }
+   // Make everything the APU has queued so far available for reading.
+   threads_exchange(&audioQueue.written, (int)audioQueue.head);
 
-         // Let the subsystem have it.
-         audiolib_free_buffer(audiolibBuffer);
+   // The audio thread takes it from here.
+   if(audioThread)
+      return;
+
+   // Wait until there is enough in the queue to fill a whole buffer.
+   const unsigned queuedFrames = audio_queue_get_frames();
+   if(queuedFrames < audio_buffer_size_frames)
+      return;
+
+   // See if we can update the driver buffer yet.
+   void* audiolibBuffer = audiolib_get_buffer(audioBuffer);
+   if(!audiolibBuffer) {
+      /* The output system can't keep up with the emulation (e.g while using fast forward), so scrap the oldest data in
+         the queue, keeping only enough to fill the buffer once it is ready. */
+      const unsigned framesToDrop = queuedFrames - audio_buffer_size_frames;
+      audio_queue_skip(framesToDrop);
+      threads_add(&audio_overruns, framesToDrop);
+
+      return;
+   }
+
+   // Fill the buffer straight from the queue, and let the subsystem have it.
+   audio_queue_read(audiolibBuffer, audio_buffer_size_frames);
+   audiolib_free_buffer(audiolibBuffer);
+
+   threads_add(&audio_fps, audio_buffer_size_frames);
+}
 
-         // Empty the internal buffer.
-         audioBufferedFrames = 0;
+void audio_suspend(void)
+{
+   DEBUG_PRINTF("audio_suspend()\n");
 
-         audio_fps += audio_buffer_size_frames;
+   if (!audio_options.enable_output)
+      return;
+
+   threads_lock(audioLock);
+   audioSuspended = true;
+   audiolib_suspend();
+   threads_unlock(audioLock);
+}
+
+void audio_resume(void)
+{
+   DEBUG_PRINTF("audio_resume()\n");
+
+   if (!audio_options.enable_output)
+      return;
+
+   threads_lock(audioLock);
+   audioSuspended = false;
+   audiolib_resume();
+   threads_unlock(audioLock);
+}
+
+// --- Audio queue. ---
+unsigned audio_queue_reserve(const unsigned count)
+{
+   /* Called by the APU when there didn't seem to be room for 'count' samples.  Catch up with the reader, which may have
+      made some room since we last looked, and return how many samples can be queued. */
+   audioQueue.limit = audioQueue.read + audioQueue.size;
+   threads_barrier();
+
+   const unsigned room = audioQueue.limit - audioQueue.head;
+   if((room < count) && audioQueue.samples) {
+      // Some frames are going to be dropped.
+      threads_add(&audio_overruns, (count - room) / audio_channels);
+   }
+
+   return room;
+}
+
+static void audio_queue_reset(void)
+{
+   audioQueue.size = 0;
+   audioQueue.mask = 0;
+
+   audioQueue.head = 0;
+   audioQueue.limit = 0;
+
+   audioQueue.written = 0;
+   audioQueue.read = 0;
+}
+
+static unsigned audio_queue_get_frames(void)
+{
+   // Returns the number of frames available for reading.
+   const unsigned written = audioQueue.written;
+   // Don't let any samples we go on to read be older than the position we just saw.
+   threads_barrier();
+
+   return (written - audioQueue.read) / audio_channels;
+}
+
+static void audio_queue_skip(const unsigned frames)
+{
+   // Discards the oldest frames in the queue, making room for the APU.
+   threads_exchange(&audioQueue.read, (int)(audioQueue.read + (frames * audio_channels)));
+}
+
+static void audio_queue_read(void* buffer, const unsigned frames)
+{
+   /* Takes frames from the queue, converting them to the subsystem's format and writing them to the buffer.  Any frames
+      that the queue can't supply are filled with silence, and counted as underruns. */
+   const unsigned queuedFrames = audio_queue_get_frames();
+   if(queuedFrames < frames)
+      threads_add(&audio_underruns, frames - queuedFrames);
+
+   const unsigned framesToRead = Minimum<unsigned>(queuedFrames, frames);
+   const unsigned samplesToRead = framesToRead * audio_channels;
+   const unsigned readBase = audioQueue.read;
+
+   unsigned offset = 0;
+   while(offset < samplesToRead) {
+      /* Read the samples out of the ring and convert them into the driver's buffer, in runs that
+         don't wrap around the end of it. The queue itself is left unchanged. */
+      const unsigned index = (readBase + offset) & audioQueue.mask;
+      const unsigned count = Minimum<unsigned>(samplesToRead - offset, audioQueue.size - index);
+
+      audio_output_block(buffer, offset, &audioQueue.samples[index], count);
+      offset += count;
+   }
+
+   const unsigned samples = frames * audio_channels;
+   if(offset < samples) {
+      // Pad the rest with silence.
+      uint16 silence[audioBlockSamples];
+      for(unsigned i = 0; i < audioBlockSamples; i++)
+         silence[i] = 0x8000;
+
+      while(offset < samples) {
+         const unsigned count = Minimum<unsigned>(samples - offset, audioBlockSamples);
+
+         audio_output_block(buffer, offset, silence, count);
+         offset += count;
       }
-      else {
-         /* This code simulates a ring buffer for when the output system can't keep up with the emulation (e.g while using
-            fast forward), by scrapping the oldest data in the buffer and adding the new data(see below).
-
-            This is functionally identical to using an actual ring buffer, though not nearly as efficient. */
-
-         // Determine how many frames are available in the queue.
-         const unsigned queuedFrames = audioQueue.size() / audio_channels;
-         if(queuedFrames > 0) {
-            // Determine how many frames we want to make room for.
-            const unsigned framesToAdd = Minimum<unsigned>(queuedFrames, audio_buffer_size_frames);
-            // Make room for the frames in the buffer.
-            const unsigned framesToMove = audioBufferedFrames - framesToAdd;
-            if(framesToMove > 0) {
-               const unsigned copyBase = ((audioBufferedFrames - framesToMove) * audio_channels) * (audio_sample_bits / 8);
-               const unsigned samplesToMove = framesToMove * audio_channels;
-               const unsigned bytesToMove = samplesToMove * (audio_sample_bits / 8);
-
-               uint8* buffer = (uint8*)audioBuffer;
-               memcpy(&buffer[0], &buffer[copyBase], bytesToMove);
-            }
-
-            audioBufferedFrames -= framesToAdd;
+   }
+
+   // Hand the space back to the APU.
+   audio_queue_skip(framesToRead);
+}
+
+static void audio_queue_resample(void* buffer, const unsigned frames, const real step)
+{
+   /* Like audio_queue_read(), but steps through the queue by 'step' frames for each frame written, interpolating between
+      them.  The fractional part of the position carries over to the next call. */
+   const unsigned queuedFrames = audio_queue_get_frames();
+   const unsigned readBase = audioQueue.read;
+
+   real position = audioResamplePosition;
+   unsigned underruns = 0;
+
+   // Interpolated samples are gathered into a block, and then converted all at once.
+   uint16 block[audioBlockSamples];
+   unsigned blockSamples = 0;
+   unsigned offset = 0;
+
+   for(unsigned frame = 0; frame < frames; frame++) {
+      const unsigned index = (unsigned)position;
+      const real fraction = position - index;
+      // Interpolation needs the frame after this one as well.
+      const bool available = (index + 1) < queuedFrames;
+
+      for(int channel = 0; channel < audio_channels; channel++) {
+         uint16 sample = 0x8000;
+         if(available) {
+            const real first = audioQueue.samples[(readBase + (index * audio_channels) + channel) & audioQueue.mask];
+            const real second = audioQueue.samples[(readBase + ((index + 1) * audio_channels) + channel) & audioQueue.mask];
+            sample = (uint16)Round<real>(first + ((second - first) * fraction));
          }
+
+         block[blockSamples++] = sample;
+      }
+
+      // The block size is a multiple of the channel count, so frames never straddle two blocks.
+      if((blockSamples == audioBlockSamples) || (frame == (frames - 1))) {
+         audio_output_block(buffer, offset, block, blockSamples);
+         offset += blockSamples;
+         blockSamples = 0;
       }
+
+      if(available)
+         position += step;
+      else
+         underruns++;
    }
 
-   if(audioBufferedFrames < audio_buffer_size_frames) {
-      // Determine how many frames are available in the queue.
-      const unsigned queuedFrames = audioQueue.size() / audio_channels;
-      if(queuedFrames > 0) {
-         // Determine how many frames are available in the buffer.
-         const unsigned bufferableFrames = audio_buffer_size_frames - audioBufferedFrames;
-         // Determine the number of frames to copy to the buffer.
-         const unsigned framesToCopy = Minimum<unsigned>(queuedFrames, bufferableFrames);
-
-         // Copy frames to the buffer.
-         for(unsigned frame = 0; frame < framesToCopy; frame++) {
-            // Read/write base addresses (read from queue, write to buffer).
-            const unsigned readBase = frame * audio_channels;
-            // audioBufferedFrames changes within the loop(see below), so all we have to do is use it as a write pointer.
-            const unsigned writeBase = audioBufferedFrames * audio_channels;
-
-            for(int channel = 0; channel < audio_channels; channel++) {
-               // Fetch a sample from the queue.
-               uint16 sample = audioQueue[readBase + channel];
-
-               if(audioVisBuffer) {
-                  // Buffer it for visualization.
-                  audioVisBuffer[audioVisBufferOffset] = sample;
-                  audioVisBufferOffset++;
-                  if(audioVisBufferOffset > audioVisBufferTail) { 
-                     // The buffer has filled up.
-                     if(audioVisBufferOffset > (audioVisBufferSize - 1))
-                        audioVisBufferOffset = 0;
-
-                     // Move head and tail, wrapping around if neccessary.
-                     audioVisBufferHead++;
-                     if(audioVisBufferHead > (audioVisBufferSize - 1))
-                        audioVisBufferHead = 0;
-
-                     audioVisBufferTail++;
-                     if(audioVisBufferTail > (audioVisBufferSize - 1))
-                        audioVisBufferTail = 0;
-                  }
-               }
-
-               if(audio_signed_samples) {
-                  // Convert to signed.
-                  sample ^= 0x8000;
-               }
-
-               /* Determine our write offset for the buffer (this remains constant regardless of the value of sample_bits
-                  since we cast the buffer to an appropriately sized data type). */
-               const unsigned writeOffset = writeBase + channel;
-
-               // Write our sample to the buffer.
-               switch(audio_sample_bits) {
-                  case 8: {
-                     // Reduce to 8 bits.
-                     sample >>= 8;
-
-                     uint8* buffer = (uint8*)audioBuffer;
-                     buffer[writeOffset] = sample;
-
-                     if(wavFile) {
-                        if(audio_signed_samples) {
-                           // Convert to unsigned.
-                           sample ^= 0x80;
-                        }
-
-                        wavFile->write_byte(wavFile, sample);
-                        wavSize++;
-                     }
-
-                     break;
-                  }
-
-                  case 16: {
-                     uint16* buffer = (uint16*)audioBuffer;
-                     buffer[writeOffset] = sample;
-
-                     if(wavFile) {
-                        if(!audio_signed_samples) {
-                           // Convert to signed.
-                           sample ^= 0x8000;
-                        }
-
-                        // putc(sample & 0xFF, wavFile);
-                        // putc((sample & 0xFF00) >> 8, wavFile);
-			wavFile->write_word(wavFile, sample);
-                        wavSize += 2;
-                     }
-
-                     break;
-                  }
-
-                  default:
-                     WARN_GENERIC();
-               }
-            }
-
-            // Increment frame counter.
-            audioBufferedFrames++;
-         }
+   if(underruns > 0)
+      threads_add(&audio_underruns, underruns);
+
+   // Hand the whole frames we've gone past back to the APU.
+   const unsigned framesRead = (unsigned)position;
+   audioResamplePosition = position - framesRead;
+   audio_queue_skip(framesRead);
+}
 
-         // Determine how many samples we copied.
-         const unsigned samplesCopied = framesToCopy * audio_channels;
-         const unsigned samplesRemaining = audioQueue.size() - samplesCopied;
-         /* Removed copied samples from the queue.
-            Thanks KittyCat! =^-^= */
-         memcpy(&audioQueue[0], &audioQueue[samplesCopied], sizeof(uint16) * samplesRemaining);
-         audioQueue.resize(samplesRemaining);
+static void audio_output_block(void* buffer, const unsigned offset, const uint16* samples, const unsigned count)
+{
+   /* Writes a block of samples from the queue to the buffer at 'offset' in the subsystem's format, passing them on to the
+      WAV writer and the visualization buffer along the way.  The format is only looked at once per block, so that each
+      conversion is a simple loop. */
+   if(audioVisBuffer) {
+      for(unsigned i = 0; i < count; i++) {
+         // Buffer it for visualization.
+         audioVisBuffer[audioVisBufferOffset] = samples[i];
+         audioVisBufferOffset++;
+         if(audioVisBufferOffset > audioVisBufferTail) { 
+            // The buffer has filled up.
+            if(audioVisBufferOffset > (audioVisBufferSize - 1))
+               audioVisBufferOffset = 0;
+
+            // Move head and tail, wrapping around if neccessary.
+            audioVisBufferHead++;
+            if(audioVisBufferHead > (audioVisBufferSize - 1))
+               audioVisBufferHead = 0;
+
+            audioVisBufferTail++;
+            if(audioVisBufferTail > (audioVisBufferSize - 1))
+               audioVisBufferTail = 0;
+         }
       }
    }
 
-   // Check if the buffer is full.
-   if(audioBufferedFrames == audio_buffer_size_frames) {
-      // See if we can update the driver buffer yet.
-      void* audiolibBuffer = audiolib_get_buffer(audioBuffer);
-      if(audiolibBuffer) {
-         if(audiolibBuffer != audioBuffer) {
-            // Copy to external buffer.
-            memcpy(audiolibBuffer, audioBuffer, audio_buffer_size_bytes);
+   // Samples in the queue are unsigned, so converting to signed just flips the top bit.
+   const uint16 sign = audio_signed_samples ? 0x8000 : 0x0000;
+
+   /* Write our samples to the buffer (the offset remains constant regardless of the value of sample_bits since we cast the
+      buffer to an appropriately sized data type). */
+   switch(audio_sample_bits) {
+      case 8: {
+         // Reduce to 8 bits.
+         uint8* output = (uint8*)buffer + offset;
+         unsigned i = 0;
+
+#if defined(__AVX2__)
+         const __m256i signs = _mm256_set1_epi16((short)sign);
+         for(; (i + 32) <= count; i += 32) {
+            const __m256i first = _mm256_loadu_si256((const __m256i*)&samples[i]);
+            const __m256i second = _mm256_loadu_si256((const __m256i*)&samples[i + 16]);
+            const __m256i low = _mm256_srli_epi16(_mm256_xor_si256(first, signs), 8);
+            const __m256i high = _mm256_srli_epi16(_mm256_xor_si256(second, signs), 8);
+
+            // Packing works within each 128-bit half, so the halves have to be put back in order.
+            _mm256_storeu_si256((__m256i*)&output[i], _mm256_permute4x64_epi64(_mm256_packus_epi16(low, high), 0xD8));
+         }
+#elif defined(__SSSE3__)
+         const __m128i signs = _mm_set1_epi16((short)sign);
+         for(; (i + 16) <= count; i += 16) {
+            const __m128i first = _mm_loadu_si128((const __m128i*)&samples[i]);
+            const __m128i second = _mm_loadu_si128((const __m128i*)&samples[i + 8]);
+            const __m128i low = _mm_srli_epi16(_mm_xor_si128(first, signs), 8);
+            const __m128i high = _mm_srli_epi16(_mm_xor_si128(second, signs), 8);
+            _mm_storeu_si128((__m128i*)&output[i], _mm_packus_epi16(low, high));
+         }
+#endif
+
+         for(; i < count; i++)
+            output[i] = (samples[i] ^ sign) >> 8;
+
+         if(wavFile) {
+            // 8-bit WAV files are always unsigned.
+            for(unsigned i = 0; i < count; i++)
+               wavFile->write_byte(wavFile, samples[i] >> 8);
+
+            wavSize += count;
+         }
+
+         break;
+      }
+
+      case 16: {
+         uint16* output = (uint16*)buffer + offset;
+         unsigned i = 0;
+
+#if defined(__AVX2__)
+         const __m256i signs = _mm256_set1_epi16((short)sign);
+         for(; (i + 16) <= count; i += 16) {
+            const __m256i input = _mm256_loadu_si256((const __m256i*)&samples[i]);
+            _mm256_storeu_si256((__m256i*)&output[i], _mm256_xor_si256(input, signs));
+         }
+#elif defined(__SSSE3__)
+         const __m128i signs = _mm_set1_epi16((short)sign);
+         for(; (i + 8) <= count; i += 8) {
+            const __m128i input = _mm_loadu_si128((const __m128i*)&samples[i]);
+            _mm_storeu_si128((__m128i*)&output[i], _mm_xor_si128(input, signs));
          }
+#endif
 
-         // Let the subsystem have it.
-         audiolib_free_buffer(audiolibBuffer);
+         for(; i < count; i++)
+            output[i] = samples[i] ^ sign;
 
-         // Empty the internal buffer.
-         audioBufferedFrames = 0;
+         if(wavFile) {
+            // 16-bit WAV files are always signed.
+            for(unsigned i = 0; i < count; i++)
+               wavFile->write_word(wavFile, samples[i] ^ 0x8000);
 
-         audio_fps += audio_buffer_size_frames;
+            wavSize += count * 2;
+         }
+
+         break;
       }
+
+      default:
+         WARN_GENERIC();
    }
 }
 
-void audio_suspend(void)
+// --- Audio thread. ---
+static bool audio_can_thread(void)
 {
-   DEBUG_PRINTF("audio_suspend()\n");
+   // There's no point in a separate thread unless there's a spare processor to run it.
+   if(threads_get_count() < 2)
+      return false;
 
-   if (!audio_options.enable_output)
-      return;
+   /* The null subsystem takes output as fast as it is produced, and should always get exactly the same output, so it has
+      to be fed directly.  Safe mode is meant to be as simple as possible. */
+   if((audio_options.subsystem == AUDIO_SUBSYSTEM_NONE) || (audio_options.subsystem == AUDIO_SUBSYSTEM_SAFE))
+      return false;
 
-   audiolib_suspend();
+   return true;
 }
 
-void audio_resume(void)
+static void audio_start_thread(void)
 {
-   DEBUG_PRINTF("audio_resume()\n");
+   if(!audio_can_thread())
+      return;
 
-   if (!audio_options.enable_output)
+   audioLock = threads_create_lock();
+   if(!audioLock) {
+      audio_stop_thread();
+      return;
+   }
+
+   /* Aim to keep two buffers' worth in the queue, measured as the subsystem asks for more: one to hand over right away,
+      and another to cover the time until it next asks. */
+   audioQueueTarget = audio_buffer_size_frames * 2;
+   audioQueueFill = audioQueueTarget;
+   audioResamplePosition = 0.0;
+
+   audioSuspended = false;
+   audioPrimed = false;
+
+   audioThread = threads_start(audio_thread, null);
+   if(!audioThread) {
+      audio_stop_thread();
       return;
+   }
 
-   audiolib_resume();
+   log_printf("AUDIO: Audio will be fed from a separate thread.\n");
+}
+
+static void audio_stop_thread(void)
+{
+   if(audioThread) {
+      threads_stop(audioThread);
+      audioThread = null;
+   }
+
+   if(audioLock) {
+      threads_destroy_lock(audioLock);
+      audioLock = null;
+   }
+}
+
+static void audio_thread(THREAD* thread, void* data)
+{
+   while(!threads_should_stop(thread)) {
+      threads_lock(audioLock);
+      const bool fed = audio_feed();
+      threads_unlock(audioLock);
+
+      if(!fed)
+         threads_sleep(thread, audioThreadTimeout);
+   }
+}
+
+static bool audio_feed(void)
+{
+   // Gives the subsystem a buffer's worth from the queue if it has room for it, and returns whether it did.
+   if(audioSuspended)
+      return false;
+
+   unsigned queuedFrames = audio_queue_get_frames();
+   if(!audioPrimed) {
+      /* Wait for the queue to fill up at first, rather than starting off with a run of underruns.  Subsystems usually
+         take a couple of buffers straight away, so allow for an extra one. */
+      if(queuedFrames < (audioQueueTarget + audio_buffer_size_frames))
+         return false;
+
+      audioPrimed = true;
+   }
+
+   if(queuedFrames > (audioQueueTarget + (audio_buffer_size_frames * 2))) {
+      /* The emulation is getting further ahead than rate control could ever make up for (e.g while using fast forward),
+         so scrap the oldest data in the queue, going back down to the target. */
+      const unsigned framesToDrop = queuedFrames - audioQueueTarget;
+      audio_queue_skip(framesToDrop);
+      threads_add(&audio_overruns, framesToDrop);
+
+      queuedFrames = audioQueueTarget;
+      audioQueueFill = audioQueueTarget;
+   }
+
+   // See if we can update the driver buffer yet.
+   void* audiolibBuffer = audiolib_get_buffer(audioBuffer);
+   if(!audiolibBuffer)
+      return false;
+
+   // Read the queue a little faster when it is fuller than we'd like, and a little slower when it is emptier.
+   audioQueueFill += (queuedFrames - audioQueueFill) * audioRateSmoothing;
+   const real error = (audioQueueFill - audioQueueTarget) / audioQueueTarget;
+   const real step = 1.0 + Clamp<real>(error * audioRateGain * audioRateRange, -audioRateRange, audioRateRange);
+
+   audio_queue_resample(audiolibBuffer, audio_buffer_size_frames, step);
+   audiolib_free_buffer(audiolibBuffer);
+
+   threads_add(&audio_fps, audio_buffer_size_frames);
+
+   return true;
 }
 
 // --- WAV recording functions. ---
@@ -428,22 +748,30 @@ int audio_open_wav(const UTF_STRING* filename)
    Safeguard(filename);
 
    /* Open file. */
-   wavFile = open_file(filename, FILE_MODE_WRITE, FILE_ORDER_INTEL);
-   if(!wavFile)
+   FILE_CONTEXT* file = open_file(filename, FILE_MODE_WRITE, FILE_ORDER_INTEL);
+   if(!file)
       return 1;
 
    // Skip header space.
-   wavFile->seek_to(wavFile, WAV_HEADER_SIZE);
+   file->seek_to(file, WAV_HEADER_SIZE);
+
+   // Samples are written from the audio thread, if there is one.
+   threads_lock(audioLock);
 
+   wavFile = file;
    // Clear size counter.
    wavSize = 0;
 
+   threads_unlock(audioLock);
+
    // Return success.
    return 0;
 }
 
 void audio_close_wav(void)
 {
+   threads_lock(audioLock);
+
    if(wavFile) {
       // Write header.
       wavFile->seek_to(wavFile, 0);
@@ -482,18 +810,24 @@ void audio_close_wav(void)
       // Clear counter.
       wavSize = 0;
    }
+
+   threads_unlock(audioLock);
 }
 
 // --- Visualization support ---
 void audio_visopen(unsigned num_frames)
 {
    // Attempts to open a visualization buffer (no error checking - use audio_get_visdata() for that instead).
+   threads_lock(audioLock);
    audioVisBufferSize = num_frames * audio_channels;
    audioVisBuffer = new uint16[audioVisBufferSize];
+   threads_unlock(audioLock);
 }
 
 void audio_visclose(void)
 {
+   threads_lock(audioLock);
+
    if(audioVisBuffer) {
       // Destroy visualization buffer.
       delete[] audioVisBuffer;
@@ -501,6 +835,8 @@ void audio_visclose(void)
    }
 
    audioVisBufferSize = 0;
+
+   threads_unlock(audioLock);
 }
 
 
@@ -526,6 +862,9 @@ UINT16* audio_get_visdata(void)
       return null;
    }
 
+   threads_lock(audioLock);
    memcpy(&visdata[0], &audioVisBuffer[0], audioVisBufferSize * sizeof(uint16));
+   threads_unlock(audioLock);
+
    return visdata;
 }
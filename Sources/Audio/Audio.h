@@ -34,6 +34,11 @@ typedef struct audio_options_s {
 extern audio_options_t audio_options;
 
 extern volatile int audio_fps;
+extern volatile int audio_overruns;
+extern volatile int audio_underruns;
+
+/* With AUDIO_SUBSYSTEM_NONE, output is not played but passed to this instead, if set. */
+extern void (*audio_null_output)(const void* buffer, const unsigned size);
 
 extern void audio_load_config(void);
 extern void audio_save_config(void);
@@ -15,6 +15,8 @@
 
 static AudiolibDriver *audiolibDriver = null;
 
+void (*audio_null_output)(const void* buffer, const unsigned size) = null;
+
 int audiolib_init(void)
 {
    DEBUG_PRINTF("audiolib_init()\n");
@@ -25,6 +27,23 @@ int audiolib_init(void)
    }
    
    switch(audio_options.subsystem) {
+      case AUDIO_SUBSYSTEM_NONE: {
+         audiolibDriver = new AudiolibNullDriver;
+         if(!audiolibDriver) {
+            log_printf("AUDIOLIB: audiolib_init(): Creating of audio driver failed for AUDIO_SUBSYSTEM_NONE.");
+            audiolib_exit();
+            return 1;
+         }
+
+         const int result = audiolibDriver->initialize();
+         if(result != 0) {
+            log_printf("AUDIOLIB: audiolib_init(): Initialization of audio driver failed for AUDIO_SUBSYSTEM_NONE.");
+            audiolib_exit();
+            return 8 + result;
+         }
+
+         break;
+      }
 
 #ifndef USE_OPENAL
       case AUDIO_SUBSYSTEM_AUTOMATIC:
@@ -214,8 +233,8 @@ int AudiolibAllegroDriver::initialize(void)
    audio_signed_samples = FALSE;
 
    if(audio_options.buffer_length_ms_hint == -1) {
-      // 75ms should do.
-      audio_buffer_length_ms = 75;
+      // Let the audio system decide.
+      audio_buffer_length_ms = audio_default_buffer_length_ms;
    }
    else
       audio_buffer_length_ms = audio_options.buffer_length_ms_hint;
@@ -327,6 +346,43 @@ void AudiolibAllegroDriver::resume(void)
    voice_start(stream->voice);
 }
 
+// --- Null driver. ---
+int AudiolibNullDriver::initialize(void)
+{
+   /* There is no hardware to match, so just use a fixed format. This is signed since that
+      is the natural format for anything processing the output (e.g hashing or WAV files). */
+   if(audio_options.sample_rate_hint == -1)
+      audio_sample_rate = 48000;
+   else
+      audio_sample_rate = audio_options.sample_rate_hint;
+
+   audio_sample_bits = 16;
+   audio_signed_samples = TRUE;
+
+   if(audio_options.buffer_length_ms_hint == -1)
+      audio_buffer_length_ms = audio_default_buffer_length_ms;
+   else
+      audio_buffer_length_ms = audio_options.buffer_length_ms_hint;
+
+   return 0;
+}
+
+void* AudiolibNullDriver::getBuffer(void* buffer)
+{
+   RT_ASSERT(buffer);
+
+   // Always ready for more, and the buffer can be used as it is.
+   return buffer;
+}
+
+void AudiolibNullDriver::freeBuffer(void* buffer)
+{
+   RT_ASSERT(buffer);
+
+   if(audio_null_output)
+      audio_null_output(buffer, audio_buffer_size_bytes);
+}
+
 #if defined(USE_OPENAL)
 // --- OpenAL driver. ---
 #define AUDIOLIB_OPENAL_BUFFERS	2
@@ -377,8 +433,8 @@ int AudiolibOpenALDriver::initialize(void)
    audio_signed_samples = TRUE;
 
    if(audio_options.buffer_length_ms_hint == -1) {
-      // 75ms should do.
-      audio_buffer_length_ms = 75;
+      // Let the audio system decide.
+      audio_buffer_length_ms = audio_default_buffer_length_ms;
    }
    else
       audio_buffer_length_ms = audio_options.buffer_length_ms_hint;
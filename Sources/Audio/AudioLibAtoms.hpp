@@ -42,6 +42,15 @@ private:
    AUDIOSTREAM* stream;
 };
 
+// Driver for AUDIO_SUBSYSTEM_NONE, which takes output as fast as it is produced.
+class AudiolibNullDriver : public AudiolibDriver {
+public:
+   int initialize(void);
+   int openStream(void) { return 0; }
+   void* getBuffer(void* buffer);
+   void freeBuffer(void* buffer);
+};
+
 #if defined(USE_OPENAL)
 class AudiolibOpenALDriver : public AudiolibDriver {
 public:
@@ -18,6 +18,7 @@ extern int audio_sample_rate;
 extern int audio_sample_bits;
 extern BOOL audio_signed_samples;
 extern int audio_buffer_length_ms;
+extern int audio_default_buffer_length_ms;
 
 extern unsigned audio_buffer_size_frames;
 extern unsigned audio_buffer_size_samples;
@@ -26,18 +27,104 @@ extern unsigned audio_buffer_size_bytes;
 #ifdef __cplusplus
 } // extern "C"
 
-#include <vector>
 #include "Common/Math.h"
 
-extern std::vector<uint16> audioQueue;
+// Samples are converted for the queue using SIMD when available.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+/* Single-producer/single-consumer ring buffer that holds samples on their way from the APU to the audio
+   driver. See Audio.cpp for the details. Positions are free-running counts of samples, which are masked
+   down to the size of the buffer (always a power of two) when indexing it. */
+typedef struct _AudioQueue {
+   uint16* samples;
+   unsigned size;
+   unsigned mask;
+
+   // Writer side, only ever touched by the APU.
+   unsigned head;  // Position of the next sample to write.
+   unsigned limit; // Position the head can't go past, as of the last time the reader was checked.
+
+   // Positions published by the writer and the reader respectively, see threads_exchange().
+   volatile int written;
+   volatile int read;
+
+} AudioQueue;
+
+extern AudioQueue audioQueue;
 
-// Keep this inline and using references for speed.
-express_function void audio_queue_sample(const real& sample)
+extern unsigned audio_queue_reserve(const unsigned count);
+
+/* Queues a block of samples, which must be made up of whole frames.  This is kept inline so that the conversion is
+   compiled along with the APU's own post-processing. */
+express_function void audio_queue_samples(const real* samples, const unsigned count)
 {
-   // Convert to 16-bit unsigned and clip.
-   const uint16 packed = (((int16)Clamp<int>( Round<real>(sample * 32768.0), -32768, 32767 )) ^ 0x8000);
-   // Store it in the queue.
-   audioQueue.push_back(packed);
+   AudioQueue& queue = audioQueue;
+
+   unsigned room = queue.limit - queue.head;
+   if(room < count) {
+      /* If there isn't room for everything, as much as will fit is queued and the rest is dropped. The room is always
+         a whole number of frames, so the channels stay paired up. */
+      room = audio_queue_reserve(count);
+   }
+
+   const unsigned samplesToQueue = Minimum<unsigned>(count, room);
+
+   unsigned offset = 0;
+   while(offset < samplesToQueue) {
+      // Convert in runs that don't wrap around the end of the queue.
+      const unsigned index = (queue.head + offset) & queue.mask;
+      const unsigned run = Minimum<unsigned>(samplesToQueue - offset, queue.size - index);
+
+      const real* input = &samples[offset];
+      uint16* output = &queue.samples[index];
+
+      unsigned i = 0;
+
+#if defined(__AVX2__) || defined(__SSSE3__)
+      /* This converts 8 samples at a time. Truncating (x * 32768) + 0.5 matches Round(), and packing with signed
+         saturation clips to 16 bits the same way as Clamp(), including for samples that are too large to convert at all,
+         which come out as the smallest integer either way. */
+      const __m128i sign = _mm_set1_epi16((short)0x8000);
+#endif
+
+#if defined(__AVX2__)
+      const __m256d scale = _mm256_set1_pd(32768.0);
+      const __m256d half = _mm256_set1_pd(0.5);
+
+      for(; (i + 8) <= run; i += 8) {
+         const __m128i low = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&input[i]), scale), half));
+         const __m128i high = _mm256_cvttpd_epi32(_mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&input[i + 4]), scale), half));
+         _mm_storeu_si128((__m128i*)&output[i], _mm_xor_si128(_mm_packs_epi32(low, high), sign));
+      }
+#elif defined(__SSSE3__)
+      const __m128d scale = _mm_set1_pd(32768.0);
+      const __m128d half = _mm_set1_pd(0.5);
+
+      for(; (i + 8) <= run; i += 8) {
+         __m128i converted[4];
+         for(int j = 0; j < 4; j++)
+            converted[j] = _mm_cvttpd_epi32(_mm_add_pd(_mm_mul_pd(_mm_loadu_pd(&input[i + (j * 2)]), scale), half));
+
+         // Each conversion fills only the lower half of its register.
+         const __m128i low = _mm_unpacklo_epi64(converted[0], converted[1]);
+         const __m128i high = _mm_unpacklo_epi64(converted[2], converted[3]);
+         _mm_storeu_si128((__m128i*)&output[i], _mm_xor_si128(_mm_packs_epi32(low, high), sign));
+      }
+#endif
+
+      for(; i < run; i++) {
+         // Convert to 16-bit unsigned and clip.
+         output[i] = (((int16)Clamp<int>( Round<real>(input[i] * 32768.0), -32768, 32767 )) ^ 0x8000);
+      }
+
+      offset += run;
+   }
+
+   queue.head += samplesToQueue;
 }
 
 #endif /* __cplusplus */
@@ -33,6 +33,7 @@
 #include "Platform/Config.h"
 #include "Platform/File.h"
 #include "Platform/Log.h"
+#include "System/Benchmark.h"
 #include "System/Machine.h"
 #include "System/Timing.h"
 #include "Toolkit/Unicode.h"
@@ -21,6 +21,9 @@ bool initialized = false;
 // Current execution model. See 'CPU.h' for details.
 CPU_EXECUTION_MODEL executionModel = CPU_EXECUTION_MODEL_DEFAULT;
 
+// Whether idle loops are skipped, for any execution model.
+bool idleSkipping = false;
+
 /* This table maps symbolic CPU interrupt types (e.g MMC) to
    generic NMI or IRQ interrupts in the core. */
 typedef map<CPU_INTERRUPT,COREInterruptType> InterruptTableType;
@@ -43,6 +46,9 @@ CPU__ARRAY( INT8,              cpu__read_patch,    CPU__READ_PATCH_SIZE    );
 CPU__ARRAY( UINT8*,            cpu__write_address, CPU__WRITE_ADDRESS_SIZE );
 CPU__ARRAY( CPU_WRITE_HANDLER, cpu__write_handler, CPU__WRITE_HANDLER_SIZE );
 
+// Active patches in each page.
+CPU__ARRAY( UINT8, cpu__read_patch_pages, CPU__READ_PATCH_PAGES_SIZE );
+
 // Internal and external (cartridge) memory.
 CPU__ARRAY( UINT8, cpu__save_ram,  CPU__SAVE_RAM_SIZE );
 CPU__ARRAY( UINT8, cpu__work_ram,  CPU__WORK_RAM_SIZE );
@@ -50,6 +56,8 @@ CPU__ARRAY( UINT8, cpu__work_ram,  CPU__WORK_RAM_SIZE );
 // Function prototypes.
 static UINT8 DummyRead(const UINT16 address);
 static void DummyWrite(const UINT16 address, const UINT8 data);
+static UINT8 PatchedRead(const UINT16 address);
+static void UpdatePatchedPages(const int start, const int pages);
 
 // ----------------------------------------------------------------------
 
@@ -73,11 +81,15 @@ void cpu_load_config(void)
          executionModel = CPU_EXECUTION_MODEL_DEFAULT;
       }
    }
+
+   idleSkipping = get_config_int("system", "idle_skipping", idleSkipping);
+   CORE::SetIdleSkipping(idleSkipping);
 }
 
 void cpu_save_config(void)
 {
    set_config_int("system", "execution_model", executionModel);
+   set_config_int("system", "idle_skipping", idleSkipping);
 }
 
 int cpu_init(void)
@@ -87,10 +99,23 @@ int cpu_init(void)
       return 1;
    }
 
+   // Each machine context has its own memory map, RAM and core.
+   MACHINE_REGISTER_STATE(initialized);
+   MACHINE_REGISTER_STATE(cpu__read_address);
+   MACHINE_REGISTER_STATE(cpu__read_handler);
+   MACHINE_REGISTER_STATE(cpu__read_patch);
+   MACHINE_REGISTER_STATE(cpu__read_patch_pages);
+   MACHINE_REGISTER_STATE(cpu__write_address);
+   MACHINE_REGISTER_STATE(cpu__write_handler);
+   MACHINE_REGISTER_STATE(cpu__save_ram);
+   MACHINE_REGISTER_STATE(cpu__work_ram);
+   CORE::RegisterState();
+
    // Clear arrays.
    memset(cpu__read_address,   0, CPU__READ_ADDRESS_SIZE);
    memset(cpu__read_handler,   0, CPU__READ_HANDLER_SIZE);
    memset(cpu__read_patch,     0, CPU__READ_PATCH_SIZE);
+   memset(cpu__read_patch_pages, 0, CPU__READ_PATCH_PAGES_SIZE);
    memset(cpu__write_address , 0, CPU__WRITE_ADDRESS_SIZE);
    memset(cpu__write_handler,  0, CPU__WRITE_HANDLER_SIZE);
 
@@ -137,6 +162,7 @@ int cpu_init(void)
 
    /* Initialize the core. Note that this can only be done safely
       after the memory map has been initialized. */
+   CORE::SetIdleSkipping(idleSkipping);
    if(!CORE::Initialize()) {
       // The core failed to initialize.
       return 1;
@@ -174,6 +200,37 @@ void cpu_set_execution_model(const CPU_EXECUTION_MODEL model)
    executionModel = model;
 }
 
+/* Idle loop skipping. When enabled, short loops that do nothing but
+   wait for an interrupt (or for a PPU status flag) are skipped over
+   instead of being executed. cpu_get_skipped_time() returns the total
+   time skipped so far, in master clock cycles; like the cycle counter
+   it wraps around, so only compare values by subtracting.
+
+   As the PPU status flags change within scanlines, nothing is ever
+   skipped past the end of one. cpu_set_idle_line_end() tells the core
+   when the current scanline ends, and should be called before each
+   cpu_execute(); following scanlines are assumed to be back to back. */
+BOOL cpu_get_idle_skipping(void)
+{
+   return idleSkipping;
+}
+
+void cpu_set_idle_skipping(const BOOL enabled)
+{
+   idleSkipping = enabled;
+   CORE::SetIdleSkipping(idleSkipping);
+}
+
+cpu_time_t cpu_get_skipped_time(void)
+{
+   return CORE::GetSkippedTime();
+}
+
+void cpu_set_idle_line_end(const cpu_time_t time)
+{
+   CORE::SetIdleLineEnd(time, SCANLINE_CLOCKS);
+}
+
 void cpu_update(void)
 {
    // Updates the core to external timing changes.
@@ -219,7 +276,9 @@ void cpu_burn(const cpu_time_t time)
 /* Interrupt routines. cpu_set_interrupt() queues an interrupt to
    occur at a specific time (in master clock cycles), and
    cpu_clear_interrupt() both unqueues any pending interrupts and
-   acknowledges any existing interrupts. */
+   acknowledges any existing interrupts. cpu_get_next_interrupt()
+   retrieves the time of the earliest queued interrupt that has not
+   been reached yet, returning FALSE if there is none. */
 void cpu_set_interrupt(const CPU_INTERRUPT type, const cpu_time_t time)
 {
    CORE::SetInterrupt(interruptTable[type], time);
@@ -230,6 +289,18 @@ void cpu_clear_interrupt(const CPU_INTERRUPT type)
    CORE::ClearInterrupt(interruptTable[type]);
 }
 
+BOOL cpu_get_next_interrupt(cpu_time_t* time)
+{
+   Safeguard(time);
+
+   CORETime next;
+   if(!CORE::GetNextInterrupt(next))
+      return FALSE;
+
+   *time = next;
+   return TRUE;
+}
+
 /* Counter management routines. These get, set, or otherwise
    manipulate the internal cycle counter. */
 cpu_time_t cpu_get_time(void)
@@ -293,16 +364,19 @@ void cpu_load_state(FILE_CONTEXT* file, const int version)
    context.registers.x = file->read_byte(file);
    context.registers.y = file->read_byte(file);
 
-   // Load interrupt queue.
-   context.interrupts.clear();
-
+   /* Load interrupt queue. The queued types are simply marked here, the core
+      works out their order when the context is set. */
    const int count = file->read_byte(file);
    for(int i = 0; i < count; i++) {
-      COREInterrupt interrupt;
-      interrupt.type = static_cast<COREInterruptType>(file->read_byte(file));
-      interrupt.time = file->read_long(file);
+      const int type = file->read_byte(file);
+      const cpu_time_t time = file->read_long(file);
+      if((type < 0) || (type >= COREInterruptTypeCount)) {
+         WARN_GENERIC();
+         continue;
+      }
 
-      context.interrupts.push_back(interrupt);
+      context.interrupts.queued |= 1 << type;
+      context.interrupts.times[type] = time;
    }
 
    // Miscellaneous.
@@ -335,14 +409,22 @@ void cpu_save_state(FILE_CONTEXT* file, const int version)
    file->write_byte(file, context.registers.y);
 
    // Save interrupt queue.
-   file->write_byte(file, context.interrupts.size());
+   const COREInterruptQueue& queue = context.interrupts;
+
+   int count = 0;
+   for(int type = 0; type < COREInterruptTypeCount; type++) {
+      if(queue.queued & (1 << type))
+         count++;
+   }
 
-   for(COREInterruptQueue::iterator i = context.interrupts.begin(); i != context.interrupts.end(); ) {
-      COREInterrupt& interrupt = *i;
-      file->write_byte(file, interrupt.type);
-      file->write_long(file, interrupt.time);
+   file->write_byte(file, count);
 
-      i++;
+   for(int type = 0; type < COREInterruptTypeCount; type++) {
+      if(!(queue.queued & (1 << type)))
+         continue;
+
+      file->write_byte(file, type);
+      file->write_long(file, queue.times[type]);
    }
 
    // Miscellaneous.
@@ -390,6 +472,7 @@ void cpu_map_block_read_address(const UINT16 address, const int pages, const UIN
    const uint16 startAddress = start * CPU__MAP_PAGE_SIZE;
    const uint16 endAddress = startAddress + (pages * CPU__MAP_PAGE_SIZE);
    map_patches(startAddress, endAddress);
+   UpdatePatchedPages(start, pages);
 }
 
 void cpu_map_block_write_address(const UINT16 address, const int pages, UINT8* data)
@@ -508,3 +591,23 @@ static UINT8 DummyRead(const UINT16 address)
 static void DummyWrite(const UINT16 address, const UINT8 data)
 {
 }
+
+// Read handler for pages that have memory patches applied to them.
+static UINT8 PatchedRead(const UINT16 address)
+{
+   const UINT8* read = cpu__read_address[address / CPU__MAP_PAGE_SIZE];
+   return read[address & CPU__MAP_PAGE_MASK] + cpu__read_patch[address];
+}
+
+/* Installs or removes PatchedRead() for a range of pages, after the
+   patches in them have been updated by map_patches(). Pages that use a
+   read handler of their own are never patched. */
+static void UpdatePatchedPages(const int start, const int pages)
+{
+   for(int page = start; page < (start + pages); page++) {
+      if(!cpu__read_address[page])
+         continue;
+
+      cpu__read_handler[page] = cpu__read_patch_pages[page] ? PatchedRead : NULL;
+   }
+}
@@ -85,6 +85,10 @@ extern void cpu_exit(void);
 extern void cpu_reset(void);
 extern CPU_EXECUTION_MODEL cpu_get_execution_model(void);
 extern void cpu_set_execution_model(const CPU_EXECUTION_MODEL model);
+extern BOOL cpu_get_idle_skipping(void);
+extern void cpu_set_idle_skipping(const BOOL enabled);
+extern cpu_time_t cpu_get_skipped_time(void);
+extern void cpu_set_idle_line_end(const cpu_time_t time);
 extern void cpu_update(void);
 extern UINT8 cpu_read(const UINT16 address);
 extern void cpu_write(const UINT16 address, const UINT8 data);
@@ -92,6 +96,7 @@ extern cpu_time_t cpu_execute(const cpu_time_t time);
 extern void cpu_burn(const cpu_time_t time);
 extern void cpu_set_interrupt(const CPU_INTERRUPT type, const cpu_time_t time);
 extern void cpu_clear_interrupt(const CPU_INTERRUPT type);
+extern BOOL cpu_get_next_interrupt(cpu_time_t* time);
 extern cpu_time_t cpu_get_time(void);
 extern cpu_time_t cpu_get_time_elapsed(cpu_time_t* time);
 extern int cpu_get_register(const CPU_REGISTER index);
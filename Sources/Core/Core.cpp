@@ -45,16 +45,149 @@ const CORETime TimeTableBase[TimeTableSize] = {
 
 CORETime timeTable[TimeTableSize];
 
-/* We sort the interrupt queue by time, so that the first interrupt in the list always
-   occurs first. This allows us to simplify checks for pending interrupts to only
-   checking the first entry in the queue. */
-constant_function bool InterruptQueueTimeSorter(const COREInterrupt first, const COREInterrupt second) {
-	return first.time < second.time;
+/* Idle loop skipping. Games often spin in a short loop waiting for an interrupt, for
+   example 'JMP *', or 'LDA $2002 / BPL' to wait for vertical blanking. When enabled,
+   such loops are detected as they are executed (see Step.tpl), and once one has been
+   seen to run through completely, the clock counter is advanced past as many further
+   iterations as possible in one go. The APU and PPU catch up as they normally would.
+
+   Only loops that consist of nothing but reads with no side effects, followed by a
+   branch or jump back to the start, are considered. The only reads from I/O allowed
+   are of the PPU status register, which changes state at times that the core doesn't
+   know, so iterations are never skipped past the end of the current call to Execute(),
+   the next queued interrupt, or the end of the current scanline (as the vertical blank
+   and sprite flags only ever change within a scanline, the loop will then see the change
+   within a scanline of it happening, however long Execute() is run for). The APU status
+   register is not allowed, as reading it acknowledges the frame IRQ, which a loop polling
+   it would otherwise do every time. */
+const int IdleLoopMaxSize = 16;	// Maximum size of an idle loop, in bytes.
+
+typedef struct _IdleState {
+	bool enabled;
+
+	// The loop currently being watched, if any.
+	bool armed;
+	uint16 start;		// Address of the first instruction.
+	uint16 end;		// Address of the branch or jump back to the start.
+	int length;		// Number of instructions.
+	int steps;		// Instructions left until the end of the current iteration.
+	CORETime time;		// Time at which the current iteration began.
+
+	// The last loop found to not be idle, so it doesn't have to be checked again.
+	uint16 rejectedStart;
+	uint16 rejectedEnd;
+
+	CORETime deadline;	// Time at which the current call to Execute() ends.
+	CORETime lineEnd;	// Time at which a scanline ends (see SetIdleLineEnd()).
+	CORETime lineLength;	// Length of a scanline, or zero if unknown.
+	CORETime skipped;	// Total time skipped (wraps around).
+} IdleState;
+
+IdleState idle;
+
+// Returns true if reading from 'address' has no side effects that an idle loop could miss.
+bool IsIdleRead(const uint16 address) {
+	// Pages with memory patches have a read handler, but are otherwise plain memory.
+	const int page = address / CPU__MAP_PAGE_SIZE;
+	if(!cpu__read_handler[page] || cpu__read_address[page])
+		return true;
+
+	/* PPU status register (and mirrors). The APU status register ($4015) is excluded, as
+	   reading it clears the frame IRQ flag. */
+	if((address >= 0x2000) && (address <= 0x3FFF) && ((address & 7) == 2))
+		return true;
+
+	return false;
 }
 
-// Similarly, NMI generally takes priority over IRQ.
-constant_function bool InterruptQueuePrioritySorter(const COREInterrupt first, const COREInterrupt second) {
-	return (first.type == COREInterruptNMI);
+/* Checks if the code from 'start' to 'end' (the address of the instruction that jumps back
+   to 'start') is an idle loop. Returns the number of instructions in the loop, or zero if
+   it isn't one. */
+int CheckIdleLoop(const uint16 start, const uint16 end) {
+	int length = 0;
+	uint32 current = start;
+	while(current <= end) {
+		// Code that runs from I/O registers can't be reasoned about.
+		if(cpu__read_handler[current / CPU__MAP_PAGE_SIZE])
+			return 0;
+
+		const uint8 opcode = cpu__fast_read(current);
+		length++;
+
+		switch(opcode) {
+			case 0xEA:						// NOP
+				current += 1;
+				break;
+
+			case 0xA9: case 0xA2: case 0xA0:			// LDA, LDX, LDY #
+			case 0xC9: case 0xE0: case 0xC0:			// CMP, CPX, CPY #
+			case 0x29: case 0x09:					// AND, ORA #
+			case 0xA5: case 0xA6: case 0xA4: case 0x24:		// LDA, LDX, LDY, BIT zp
+			case 0xC5: case 0xE4: case 0xC4:			// CMP, CPX, CPY zp
+			case 0x25: case 0x05:					// AND, ORA zp
+				current += 2;
+				break;
+
+			case 0xAD: case 0xAE: case 0xAC: case 0x2C:		// LDA, LDX, LDY, BIT abs
+			case 0xCD: case 0xEC: case 0xCC:			// CMP, CPX, CPY abs
+			case 0x2D: case 0x0D: {					// AND, ORA abs
+				byte_pair address;
+				address.bytes.low = cpu__fast_read(current + 1);
+				address.bytes.high = cpu__fast_read(current + 2);
+				if(!IsIdleRead(address.word))
+					return 0;
+
+				current += 3;
+				break;
+			}
+
+			case 0x10: case 0x30: case 0x50: case 0x70:		// Bxx
+			case 0x90: case 0xB0: case 0xD0: case 0xF0:
+			case 0x4C:						// JMP abs
+				// This must be the instruction that jumps back to the start.
+				return (current == end) ? length : 0;
+
+			default:
+				return 0;
+		}
+	}
+
+	return 0;
+}
+
+// Bit in COREInterruptQueue::queued representing a given interrupt type.
+constant_function uint8 InterruptBit(const COREInterruptType type) {
+	return 1 << type;
+}
+
+/* This returns true if 'time' has been reached by the clock counter. As the clock
+   counter wraps, the comparison has to be made on the difference. */
+express_function bool TimeReached(const CORETime time) {
+	return ((CORETimeDelta)core.time - (CORETimeDelta)time) >= 0;
+}
+
+/* Rebuilds the cached first interrupt of a queue. This only has to look at a handful
+   of slots, so it is done whenever the contents of the queue change, rather than
+   keeping them sorted. */
+void UpdateInterruptQueue(COREInterruptQueue& queue) {
+	queue.first = COREInterruptNMI;
+	queue.next = 0;
+
+	bool found = false;
+	for(int i = 0; i < COREInterruptTypeCount; i++) {
+		const COREInterruptType type = static_cast<COREInterruptType>(i);
+		if(!(queue.queued & InterruptBit(type)))
+			continue;
+
+		/* Only an earlier time replaces the current first interrupt, and as NMI has
+		   the lowest type it is checked first, so it wins any ties. */
+		const CORETime time = queue.times[type];
+		if(!found || (((CORETimeDelta)time - (CORETimeDelta)queue.next) < 0)) {
+			queue.first = type;
+			queue.next = time;
+			found = true;
+		}
+	}
 }
 
 } // namespace anonymous
@@ -80,6 +213,13 @@ bool Initialize() {
 
 	BuildTimeTable();
 
+	// Build the opcode dispatch tables, if the dispatch method uses any.
+	Templates::BuildDispatchTableFast();
+	Templates::BuildDispatchTable();
+	Templates::BuildDispatchTableAsynchronous();
+
+	idle.armed = false;
+
 	return true;
 }
 
@@ -89,19 +229,27 @@ bool Initialize() {
     The I flag was set (status ORed with $04)  */
 void Reset() {
 	core.time = 0;
-	core.interrupts.clear();
+	memset(&core.interrupts, 0, sizeof(COREInterruptQueue));
 	core.afterCLI = false;
 
 	_PCL = cpu_read(COREInterruptVectorRESET);
 	_PCH = cpu_read(COREInterruptVectorRESET + 1);
 	_S -= 3;
 	SetFlag(_IF, true);
+
+	idle.armed = false;
 }
 
 linear_function CORETime Execute(const CORETime time) {
 	// Grab our initial timestamp so we can avoid emulating for too long.
 	const CORETime timestamp = core.time;
+	// Idle loops can't be skipped past this point, either.
+	idle.deadline = timestamp + time;
 
+#if defined(COREDispatchGoto)
+	// The same loop, but direct-threaded (see Opcodes.tpl).
+	return Templates::Run(time, false);
+#else
 	while(true) {
 		// Execute a single instruction or interrupt.
 		Templates::Step();
@@ -111,11 +259,20 @@ linear_function CORETime Execute(const CORETime time) {
 		if(timeElapsed >= time)
 			return timeElapsed;
 	}
+#endif
 }
 
+#if defined(COREDispatchGoto)
+#define ExecuteTemplate(_Suffix) \
+linear_function CORETime Execute##_Suffix(const CORETime time) { \
+	idle.deadline = core.time + time; \
+	return Templates::Run##_Suffix(time, false); \
+}
+#else
 #define ExecuteTemplate(_Suffix) \
 linear_function CORETime Execute##_Suffix(const CORETime time) { \
 	const CORETime timestamp = core.time; \
+	idle.deadline = timestamp + time; \
 	while(true) { \
 		Templates::Step##_Suffix(); \
 		const CORETime timeElapsed = (CORETimeDelta)core.time - (CORETimeDelta)timestamp; \
@@ -123,6 +280,7 @@ linear_function CORETime Execute##_Suffix(const CORETime time) { \
 			return timeElapsed; \
 	} \
 }
+#endif
 
 // Generate the Execute() variants.
 ExecuteTemplate(Fast)
@@ -135,30 +293,85 @@ void Burn(const CORETime time) {
 	core.time += time;
 }
 
-// This queues an interrupt of a given type to occur at 'time'.
+/* This queues an interrupt of a given type to occur at 'time'. If one of the same type
+   is already queued, the earliest of the two is kept. */
 void SetInterrupt(const COREInterruptType type, const CORETime time) {
-	COREInterrupt interrupt;
-	interrupt.type = type;
-	interrupt.time = time;
-	core.interrupts.push_back(interrupt);
-
-	// Sort the interrupt queue by time (ascending) and priority (NMIs first).
-	core.interrupts.sort(InterruptQueueTimeSorter);
-	core.interrupts.sort(InterruptQueuePrioritySorter);
+	COREInterruptQueue& queue = core.interrupts;
+	const uint8 bit = InterruptBit(type);
+	if((queue.queued & bit) && (((CORETimeDelta)queue.times[type] - (CORETimeDelta)time) <= 0))
+		return;
+
+	queue.queued |= bit;
+	queue.times[type] = time;
+
+	// Only this interrupt can have become the first one.
+	if((queue.queued == bit) || (((CORETimeDelta)time - (CORETimeDelta)queue.next) < 0) ||
+	   ((time == queue.next) && (type < queue.first))) {
+		queue.first = type;
+		queue.next = time;
+	}
 }
 
-/* This clears all interrupts of a given type, even if more than one is set to occur
-   at different times. The interrupts are both unqueued and acknowledged. */
+/* This clears any interrupt of a given type. The interrupt is both unqueued and
+   acknowledged. */
 void ClearInterrupt(const COREInterruptType type) {
-	for(COREInterruptQueue::iterator i = core.interrupts.begin(); i != core.interrupts.end(); ) {
-		COREInterrupt& interrupt = *i;
-		if(interrupt.type != type) {
-			i++;
+	COREInterruptQueue& queue = core.interrupts;
+	const uint8 bit = InterruptBit(type);
+	if(!(queue.queued & bit))
+		return;
+
+	queue.queued &= ~bit;
+	if(queue.first == type)
+		UpdateInterruptQueue(queue);
+}
+
+/* This finds the earliest queued interrupt that the clock counter has not reached yet,
+   which is as far as the CPU can be run before anything else needs to look at it.
+   Interrupts that are already due but waiting on the I flag are ignored. */
+bool GetNextInterrupt(CORETime& time) {
+	const COREInterruptQueue& queue = core.interrupts;
+
+	bool found = false;
+	for(int i = 0; i < COREInterruptTypeCount; i++) {
+		const COREInterruptType type = static_cast<COREInterruptType>(i);
+		if(!(queue.queued & InterruptBit(type)) || TimeReached(queue.times[type]))
 			continue;
-		}
 
-		i = core.interrupts.erase(i);
+		if(!found || (((CORETimeDelta)queue.times[type] - (CORETimeDelta)time) < 0)) {
+			time = queue.times[type];
+			found = true;
+		}
 	}
+
+	return found;
+}
+
+/* Enables or disables idle loop skipping, for all execution modes. GetSkippedTime() returns
+   the total time that has been skipped, in master clock cycles. Like the clock counter, this
+   wraps around, so only differences between two values of it are meaningful. */
+void SetIdleSkipping(const bool enabled) {
+	idle.enabled = enabled;
+	idle.armed = false;
+}
+
+CORETime GetSkippedTime() {
+	return idle.skipped;
+}
+
+/* Sets the time at which the current scanline ends, and the length of each scanline. Idle
+   loops are never skipped past the end of a scanline, including those after this one. */
+void SetIdleLineEnd(const CORETime time, const CORETime length) {
+	idle.lineEnd = time;
+	idle.lineLength = length;
+}
+
+/* Makes the internal state of the core part of the current machine context, so that each
+   context has a core of its own. This must be called before Initialize(). */
+void RegisterState() {
+	MACHINE_REGISTER_STATE(core);
+	MACHINE_REGISTER_STATE(timeStep);
+	MACHINE_REGISTER_STATE(timeTable);
+	MACHINE_REGISTER_STATE(idle);
 }
 
 /* This returns a copy of the internal context (e.g for state saving).
@@ -169,18 +382,22 @@ void GetContext(COREContext& context) {
 }
 
 /* This sets the internal context to the contents of a user-provided one.
-   The flags are unpacked from the status register 'P'. */
+   The flags are unpacked from the status register 'P', and the interrupt queue is
+   re-checked in case it was filled in by hand (e.g when loading a state). */
 void SetContext(const COREContext& context) {
 	core = context;
 	Templates::UnpackFlags();
+	UpdateInterruptQueue(core.interrupts);
+
+	idle.armed = false;
 }
 
 // This properly initializes a context object.
 void ClearContext(COREContext& context) {
 	context.time = 0;
-	context.interrupts.clear();
 	context.afterCLI = false;
 
+	memset(&context.interrupts, 0, sizeof(COREInterruptQueue));
 	memset(&context.registers, 0, sizeof(CORERegisters));
 	memset(&context.flags, 0, sizeof(COREFlags));
 }
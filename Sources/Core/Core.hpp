@@ -12,6 +12,16 @@
 // Define this to enable some important sanity checks.
 #define COREDebug
 
+/* Opcode dispatch method (see 'Templates/Opcodes.tpl'). One of these can be defined when building,
+   otherwise a switch statement is used:
+	COREDispatchGoto	Direct-threaded computed goto through a table of labels, with each
+				opcode jumping straight to the next one (GCC and Clang only).
+	COREDispatchTable	Calls through a table of handler functions, one per opcode. */
+#if defined(COREDispatchGoto) && !defined(__GNUC__)
+#	undef COREDispatchGoto
+#	define COREDispatchTable
+#endif
+
 // Data types to hold execution times:
 typedef uint32 CORETime;	// Absolute, used for timestamps, durations, etc.
 typedef int32 CORETimeDelta;	// Relative, used for time deltas.
@@ -35,7 +45,10 @@ enum COREInterruptType {
 	COREInterruptIRQ1,	// Additional IRQ sources (1-4). 
 	COREInterruptIRQ2,	
 	COREInterruptIRQ3,
-	COREInterruptIRQ4
+	COREInterruptIRQ4,
+
+	// Number of interrupt types, which is also the capacity of the interrupt queue.
+	COREInterruptTypeCount
 };
 
 // Interrupt vectors:
@@ -63,12 +76,20 @@ typedef struct _COREFlags {
 	uint8 n;	// Negative flag.
 } COREFlags;
 
-typedef struct _COREInterrupt {
-	COREInterruptType type;	// Where it is coming from.
-	CORETime time;		// When it will occur.
-} COREInterrupt;
-
-typedef std::list<COREInterrupt> COREInterruptQueue;
+/* The interrupt queue has a fixed capacity of one slot per interrupt type, so it
+   never allocates and can be copied around as plain data. Queueing an interrupt
+   that is already queued keeps whichever of the two occurs first, which is all the
+   core would ever see of the later one anyway.
+
+   The earliest queued interrupt is cached in 'first' and 'next', so that checking
+   for a pending interrupt is a single comparison against the clock counter. On a
+   tie, NMI takes priority over IRQ. */
+typedef struct _COREInterruptQueue {
+	uint8 queued;				// Bitmask of queued types (1 << type).
+	COREInterruptType first;		// Type of the first interrupt to occur.
+	CORETime next;				// When the first interrupt will occur.
+	CORETime times[COREInterruptTypeCount];	// When each queued interrupt will occur.
+} COREInterruptQueue;
 
 typedef struct _COREContext {
 	CORETime time;			// Execution time.
@@ -83,6 +104,7 @@ typedef struct _COREContext {
 
 namespace CORE {
 
+extern void RegisterState();
 extern bool Initialize();
 extern void Reset();
 extern linear_function CORETime Execute(const CORETime time);
@@ -91,6 +113,10 @@ extern linear_function CORETime ExecuteAsynchronous(const CORETime time);
 extern void Burn(const CORETime time);
 extern void SetInterrupt(const COREInterruptType type, const CORETime time);
 extern void ClearInterrupt(const COREInterruptType type);
+extern bool GetNextInterrupt(CORETime& time);
+extern void SetIdleSkipping(const bool enabled);
+extern CORETime GetSkippedTime();
+extern void SetIdleLineEnd(const CORETime time, const CORETime length);
 extern void GetContext(COREContext& context);
 extern void SetContext(const COREContext& context);
 extern void ClearContext(COREContext& context);
@@ -40,6 +40,16 @@ extern CPU__ARRAY( INT8,              cpu__read_patch,    CPU__READ_PATCH_SIZE
 extern CPU__ARRAY( UINT8*,            cpu__write_address, CPU__WRITE_ADDRESS_SIZE );
 extern CPU__ARRAY( CPU_WRITE_HANDLER, cpu__write_handler, CPU__WRITE_HANDLER_SIZE );
 
+/* Memory patches (e.g Game Genie codes) work by adding the values in
+   cpu__read_patch to whatever is read. So that reads from unpatched
+   pages never have to touch that table, cpu__read_patch_pages counts
+   the active patches in each page, and any page with address mapping
+   that has some also gets a read handler which applies them. This is
+   the only case where a page has both a read handler and an address. */
+#define CPU__READ_PATCH_PAGES_SIZE	CPU__MAP_PAGES
+
+extern CPU__ARRAY( UINT8, cpu__read_patch_pages, CPU__READ_PATCH_PAGES_SIZE );
+
 /* cpu__work_ram:
     This array contains the contents of work RAM (WRAM, or just RAM),
     which is general-purpose memory in the system of which the contents
@@ -71,9 +81,9 @@ EXPRESS_FUNCTION UINT8 cpu__fast_read(const UINT16 address)
       return handler(address);
    }
    else {
-      /* No read handler. */
+      /* No read handler, and therefore no patches. */
       const UINT8* read = cpu__read_address[page];
-      return read[address & CPU__MAP_PAGE_MASK] + cpu__read_patch[address];
+      return read[address & CPU__MAP_PAGE_MASK];
    }
 }
 
@@ -98,7 +108,12 @@ EXPRESS_FUNCTION void cpu__fast_write(const UINT16 address, const UINT8 data)
    zero page accesses by the core. */
 EXPRESS_FUNCTION UINT8 cpu__fast_ram_read(const UINT16 address)
 {
-   return cpu__work_ram[address] + cpu__read_patch[address];
+   const UINT8 data = cpu__work_ram[address];
+
+   if(cpu__read_patch_pages[address / CPU__MAP_PAGE_SIZE])
+      return data + cpu__read_patch[address];
+   else
+      return data;
 }
 
 EXPRESS_FUNCTION void cpu__fast_ram_write(const UINT16 address, const UINT8 data)
@@ -120,6 +120,7 @@ void map_patches(const UINT16 start_address, const UINT16 end_address)
       if(wrapper.active) {
          wrapper.active = false;
          cpu__read_patch[patch.address] = 0;
+         cpu__read_patch_pages[patch.address / CPU__MAP_PAGE_SIZE]--;
       }
 
       // Fetch the current byte from memory.
@@ -130,6 +131,7 @@ void map_patches(const UINT16 start_address, const UINT16 end_address)
       if(patch.match_value == value) {
          wrapper.active = true;
          cpu__read_patch[patch.address] = patch.value - value;
+         cpu__read_patch_pages[patch.address / CPU__MAP_PAGE_SIZE]++;
       }
    }
 }
@@ -118,6 +118,9 @@ express_function void T(InstructionBRK)() {
 	T(WriteStack)(_PCH);			// Clock 3
 	T(WriteStack)(_PCL);			// Clock 4
 	const bool interrupted = T(InterruptPending)();
+	/* The type has to be taken before the I flag is set below, as T(InterruptNext)() relies on
+	   it to tell an inhibited IRQ from one that is actually pending. */
+	const COREInterruptType type = interrupted ? T(InterruptNext)() : COREInterruptIRQ;
 	T(PackFlags)();
 	T(WriteStack)(_P | COREFlagBreak);	// Clock 5
 	// BRK and IRQ both set the I flag.
@@ -127,7 +130,7 @@ express_function void T(InstructionBRK)() {
 		/* IRQ and BRK behave identically, aside from the B flag being set,
                    so there is nothing special that needs to be done. However, if the
                    interrupt was an NMI, we have to override the vector. */
-		if(core.interrupts.front().type == COREInterruptNMI) {
+		if(type == COREInterruptNMI) {
 			// Since the NMI is actually occuring here, clear it.
 			ClearInterrupt(COREInterruptNMI);
 			// Redirect the interrupt vector to $FFFA.
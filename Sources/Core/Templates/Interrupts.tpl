@@ -8,27 +8,31 @@
 /* Checks if an interrupt is pending, either NMI or IRQ. This will not signal an IRQ as pending
    if the interrupt inhibit (I) flag is set in the processor status register. */
 express_function bool T(InterruptPending)() {
-	// Check if any interrupts are queued, and return if the queue is empty.
-	if(core.interrupts.size() == 0)
+	/* The first interrupt in the queue is cached, so all it takes to know that nothing is
+           pending is checking whether the alotted time has passed for it. */
+	if(!core.interrupts.queued || !TimeReached(core.interrupts.next))
 		return false;
 
-	/* Get the profile of the first interrupt in the queue. The interrupt queue is presorted
-           for time and priority, so they must be executed in linear order. */
-	const COREInterrupt& interrupt = core.interrupts.front();
+	// NMIs cannot be inhibited.
+	if(core.interrupts.first == COREInterruptNMI)
+		return true;
 
-	// Check if the alotted time has passed.
-	if(interrupt.time >= core.time) {
-		if(interrupt.type == COREInterruptNMI) {
-			// NMIs cannot be inhibited.
-			return true;
-		} else {
-			// The I flag prevents IRQs from occuring as long as it is set.
-			return !_IF;
-		}
-	}
+	// The I flag prevents IRQs from occuring as long as it is set.
+	if(!_IF)
+		return true;
+
+	// An inhibited IRQ must not hide an NMI queued behind it.
+	return (core.interrupts.queued & InterruptBit(COREInterruptNMI)) &&
+		TimeReached(core.interrupts.times[COREInterruptNMI]);
+}
+
+/* Returns the type of the interrupt to execute, once T(InterruptPending)() has confirmed that
+   one is pending. This is the first interrupt in the queue, unless it is an inhibited IRQ. */
+express_function COREInterruptType T(InterruptNext)() {
+	if((core.interrupts.first != COREInterruptNMI) && _IF)
+		return COREInterruptNMI;
 
-	// No interrupt is pending at this time.
-	return false;
+	return core.interrupts.first;
 }
 
 /* Executes a single interrupt and clears it if NMI or single-shot IRQ. Note that if the
@@ -40,17 +44,18 @@ express_function void T(Interrupt)(const COREInterruptType type) {
 		ClearInterrupt(type);
 	}
 
-	/* Interrupt timing is similar to BRK...
+	/* Interrupt timing is similar to BRK, except that PC is not incremented, so that
+	   the interrupted instruction is the one returned to...
 	    #  address R/W description
-	    1    PC     R  fetch opcode, increment PC
-	    2    PC     R  read next instruction byte (and throw it away), increment PC
+	    1    PC     R  fetch opcode (and throw it away)
+	    2    PC     R  read next instruction byte (and throw it away)
 	    3  $0100,S  W  push PCH on stack, decrement S
 	    4  $0100,S  W  push PCL on stack, decrement S
 	    5  $0100,S  W  push P on stack, decrement S
 	    6   $FFFE   R  fetch PCL
 	    7   $FFFF   R  fetch PCH */
-	T(DummyFetch)();			// Clock 1
-	T(DummyFetch)();			// Clock 2
+	T(DummyRead)(_PC);			// Clock 1
+	T(DummyRead)(_PC);			// Clock 2
 	T(WriteStack)(_PCH);			// Clock 3
 	T(WriteStack)(_PCL);			// Clock 4
 	T(PackFlags)();
@@ -28,8 +28,8 @@
 #include "Core/Templates/Interrupts.tpl"
 #include "Core/Templates/Instructions.tpl"
 #include "Core/Templates/Addressing.tpl"
-#include "Core/Templates/Opcodes.tpl"
 #include "Core/Templates/Step.tpl"
+#include "Core/Templates/Opcodes.tpl"
 
 // Clean up the namespace.
 #undef T__
@@ -5,40 +5,109 @@
    licensing information. You must read and accept the license prior to
    any modification or use of this software. */
 
-// This executes a single instruction or interrupt.
-static discrete_function void T(Step)() {
-	// Check if an interupt is pending.
-	if(T(InterruptPending)()) {
-		// Get the profile of the first interrupt in the queue.
-		const COREInterrupt& interrupt = core.interrupts.front();
-
-		/* In order for the interrupt to be handled before the next
-                   instruction, it needs to have occured *before* the last clock of
-                   the previous instruction. */
-		const CORETime lastClock = core.time - (1 * timeStep);
-		if(interrupt.time < lastClock) {
-			// Execute the interrupt sequence.
-			T(Interrupt)(interrupt.type);
-			// Delay instruction processing until the next call to Step().
-			return;
+/* Called after the instruction at 'address' has been executed, when idle loop skipping is
+   enabled (see Core.cpp). This watches for short jumps backwards that close an idle loop,
+   and once the loop has been run through completely, skips as many whole iterations of it
+   as possible, leaving the CPU at the start of the loop in the same state as before. This is
+   left for the compiler to inline, as the direct-threaded dispatch calls it from every opcode. */
+static void T(DetectIdleLoop)(const uint16 address) {
+	if(idle.armed && (--idle.steps < 0))
+		idle.armed = false;
+
+	// Idle loops always end by jumping backwards (or to the same instruction).
+	if((_PC > address) || ((address - _PC) >= IdleLoopMaxSize))
+		return;
+
+	if(idle.armed && (idle.steps == 0) && (idle.start == _PC) && (idle.end == address)) {
+		const CORETime iteration = (CORETimeDelta)core.time - (CORETimeDelta)idle.time;
+
+		// Stop short of the next interrupt, or the end of this call to Execute().
+		CORETime target = idle.deadline;
+		if(core.interrupts.queued &&
+		   (((CORETimeDelta)core.interrupts.next - (CORETimeDelta)target) < 0))
+			target = core.interrupts.next;
+
+		// Or the end of the current scanline, wherever that falls after the one last set.
+		if(idle.lineLength > 0) {
+			const CORETimeDelta length = idle.lineLength;
+			CORETimeDelta untilLineEnd = (CORETimeDelta)idle.lineEnd - (CORETimeDelta)core.time;
+			if(untilLineEnd < 0)
+				untilLineEnd = (length - (-untilLineEnd % length)) % length;
+
+			const CORETime lineEnd = core.time + untilLineEnd;
+			if(((CORETimeDelta)lineEnd - (CORETimeDelta)target) < 0)
+				target = lineEnd;
 		}
+
+		const CORETimeDelta remaining = (CORETimeDelta)target - (CORETimeDelta)core.time;
+		if((iteration > 0) && (remaining >= (CORETimeDelta)iteration)) {
+			const CORETime time = (remaining / iteration) * iteration;
+			core.time += time;
+#if defined(COREAsynchronous)
+			apu_execute(time);
+			ppu_execute(time);
+#endif
+			idle.skipped += time;
+		}
+
+		// Watch the next iteration, as the loop may be about to exit.
+		idle.steps = idle.length;
+		idle.time = core.time;
+		return;
+	}
+
+	if((_PC == idle.rejectedStart) && (address == idle.rejectedEnd))
+		return;
+
+	const int length = CheckIdleLoop(_PC, address);
+	if(length == 0) {
+		idle.rejectedStart = _PC;
+		idle.rejectedEnd = address;
+		return;
 	}
 
+	// Wait for one complete iteration before skipping anything.
+	idle.armed = true;
+	idle.start = _PC;
+	idle.end = address;
+	idle.length = length;
+	idle.steps = length;
+	idle.time = core.time;
+}
+
+/* Called once T(InterruptPending)() has returned true, before the next instruction. Returns
+   true if the interrupt sequence was executed, in which case instruction processing has to be
+   delayed until the next step. */
+express_function bool T(HandleInterrupt)() {
+	// Get the type and time of the interrupt that is pending.
+	const COREInterruptType type = T(InterruptNext)();
+	const CORETime time = core.interrupts.times[type];
+
+	/* In order for the interrupt to be handled before the next
+           instruction, it needs to have occured *before* the last clock of
+           the previous instruction. */
+	const CORETime lastClock = core.time - (1 * timeStep);
+	if(((CORETimeDelta)time - (CORETimeDelta)lastClock) < 0) {
+		// Execute the interrupt sequence.
+		T(Interrupt)(type);
+		idle.armed = false;
+		return true;
+	}
+
+	return false;
+}
+
+// Called before fetching the next instruction.
+express_function void T(BeginInstruction)() {
 	// Once interrupt processing is finished, we can safely handle CLI.
 	if(core.afterCLI) {
 		SetFlag(_IF, false);
 		core.afterCLI = false;
 	}
+}
 
-#if defined(COREDebug)
-	// Save the current timestamp so we can verify the execution time later.
-	const CORETime timestamp = core.time;
-#endif
-
-	// Fetch a single opcode and execute it.
-	const uint8 opcode = T(Fetch)();
-	T(ParseOpcode)(opcode);
-
+// Called after the instruction at 'address' has been executed.
+express_function void T(EndInstruction)(const uint16 address, const uint8 opcode, const CORETime timestamp) {
 #if defined(COREDebug)
 	const CORETime time = (CORETimeDelta)core.time - (CORETimeDelta)timestamp;
 	const CORETime idealTime = timeTable[opcode];
@@ -48,4 +117,34 @@ static discrete_function void T(Step)() {
                            "but the ideal execution time was %d master clocks.\n", time, idealTime);
 	}
 #endif
+
+	if(idle.enabled)
+		T(DetectIdleLoop)(address);
 }
+
+#if !defined(COREDispatchGoto)
+
+// Defined in 'Opcodes.tpl', according to the dispatch method.
+static discrete_function void T(ParseOpcode)(const uint8 opcode);
+
+// This executes a single instruction or interrupt.
+static discrete_function void T(Step)() {
+	// Check if an interupt is pending.
+	if(T(InterruptPending)() && T(HandleInterrupt)())
+		return;
+
+	// Save the current timestamp so we can verify the execution time later.
+	const CORETime timestamp = core.time;
+	// Save the address of the instruction for idle loop detection.
+	const uint16 address = _PC;
+
+	T(BeginInstruction)();
+
+	// Fetch a single opcode and execute it.
+	const uint8 opcode = T(Fetch)();
+	T(ParseOpcode)(opcode);
+
+	T(EndInstruction)(address, opcode, timestamp);
+}
+
+#endif
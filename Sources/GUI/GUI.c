@@ -207,6 +207,7 @@ static INLINE void update_menus (void)
    TOGGLE_MENU_ITEM(audio_menu_emulation_fast,         (apu_options.emulation == APU_EMULATION_FAST));
    TOGGLE_MENU_ITEM(audio_menu_emulation_accurate,     (apu_options.emulation == APU_EMULATION_ACCURATE));
    TOGGLE_MENU_ITEM(audio_menu_emulation_high_quality, (apu_options.emulation == APU_EMULATION_HIGH_QUALITY));
+   TOGGLE_MENU_ITEM(audio_menu_emulation_band_limited, (apu_options.emulation == APU_EMULATION_BAND_LIMITED));
 
    TOGGLE_MENU_ITEM(audio_menu_volume_logarithmic,    apu_options.logarithmic);
    TOGGLE_MENU_ITEM(audio_menu_volume_auto_gain,      apu_options.agc);
@@ -1482,6 +1483,7 @@ static int main_menu_cheat_manager (void)
 static int main_menu_save_snapshot (void)
 {
    int index;
+   BITMAP *snapshot;
 
    for (index = 0; index < 999; index++)
    {
@@ -1497,7 +1499,16 @@ static int main_menu_save_snapshot (void)
       if (exists (filename))
          continue;
 
-      save_bitmap (filename, video_get_render_buffer(), NULL);
+      /* Raw output from the PPU has to be turned back into colors. */
+      snapshot = video_copy_render_buffer ();
+      if (!snapshot)
+      {
+         status_text_color (GUI_ERROR_COLOR, "Couldn't save snapshot.");
+         return (D_O_K);
+      }
+
+      save_bitmap (filename, snapshot, NULL);
+      destroy_bitmap (snapshot);
 
       status_text ("Snapshot saved to %s.", filename);
 
@@ -2061,6 +2072,18 @@ static int audio_menu_emulation_high_quality (void)
    return (D_O_K);
 }
 
+static int audio_menu_emulation_band_limited (void)
+{
+   apu_options.emulation = APU_EMULATION_BAND_LIMITED;
+   update_menus ();
+
+   apu_update ();
+
+   status_text ("APU emulation quality set to band-limited.");
+
+   return (D_O_K);
+}
+
 #define AUDIO_CHANNELS_MENU_HANDLER(id, name)  \
    static int audio_channels_menu_##id (void) \
    { \
@@ -382,6 +382,7 @@ DEFINE_MENU_CALLBACK(audio_menu_enable_output);
 DEFINE_MENU_CALLBACK(audio_menu_emulation_fast);
 DEFINE_MENU_CALLBACK(audio_menu_emulation_accurate);
 DEFINE_MENU_CALLBACK(audio_menu_emulation_high_quality);
+DEFINE_MENU_CALLBACK(audio_menu_emulation_band_limited);
 DEFINE_MENU_CALLBACK(audio_menu_volume_increase);
 DEFINE_MENU_CALLBACK(audio_menu_volume_decrease);
 DEFINE_MENU_CALLBACK(audio_menu_volume_custom);
@@ -391,7 +392,7 @@ DEFINE_MENU_CALLBACK(audio_menu_volume_auto_gain);
 DEFINE_MENU_CALLBACK(audio_menu_volume_auto_normalize);
 
 /* Slot in which the "current volume" text is to placed. */
-#define AUDIO_MENU_VOLUME_TEXT   10
+#define AUDIO_MENU_VOLUME_TEXT   11
 
 static const MENU audio_menu_base[] =
 {
@@ -402,6 +403,7 @@ static const MENU audio_menu_base[] =
    { "  &Fast",           audio_menu_emulation_fast,         NULL,                             0, NULL },
    { "  &Accurate",       audio_menu_emulation_accurate,     NULL,                             0, NULL },
    { "  &High Quality",   audio_menu_emulation_high_quality, NULL,                             0, NULL },
+   { "  &Band-Limited",   audio_menu_emulation_band_limited, NULL,                             0, NULL },
    { "&Channels",         NULL,                              IMPORT_MENU(audio_channels_menu), 0, NULL },
    { "Out&put Options",   NULL,                              IMPORT_MENU(audio_output_menu),   0, NULL },
    MENU_SPLITTER,
@@ -96,7 +96,8 @@ static INLINE void update_display (void)
    if(file_is_loaded) {
       video_update_game_display();
 
-      BITMAP* render = video_get_render_buffer();
+      /* This is a copy, so that raw output from the PPU can be shown with the right colors. */
+      BITMAP* render = video_copy_render_buffer();
 
       if(render) {
          const int gameWidth = render->w;
@@ -142,6 +143,8 @@ static INLINE void update_display (void)
 
             blit(render, display, 0, 0, x, y, gameWidth, gameHeight);
          }
+
+         destroy_bitmap(render);
       }
    }
 
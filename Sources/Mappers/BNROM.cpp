@@ -106,6 +106,10 @@ static void nina_reset (void)
 
 static int nina_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(nina_prg_bank);
+   MACHINE_REGISTER_STATE(nina_chr_bank);
+
    /* Install write handlers. */
    cpu_set_write_handler_2k  (0x7800, nina_write_low);
    cpu_set_write_handler_32k (0x8000, nina_write_high);
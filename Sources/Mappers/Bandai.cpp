@@ -167,6 +167,13 @@ static void bandai_reset(void)
 
 static int bandai_init(void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(bandai_enable_irqs);
+   MACHINE_REGISTER_STATE(bandai_irq_counter);
+   MACHINE_REGISTER_STATE(bandai_irq_latch);
+   MACHINE_REGISTER_STATE(bandai_prg_bank);
+   MACHINE_REGISTER_STATE(bandai_chr_bank);
+
    /* Install write handlers. */
    cpu_set_write_handler_8k(0x6000, bandai_write);
    cpu_set_write_handler_32k(0x8000, bandai_write);
@@ -48,6 +48,9 @@ static void cnrom_reset (void)
 
 static int cnrom_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(cnrom_last_write);
+
    if (mmc_pattern_vram_in_use)
    {
       /* Mapper requires some CHR ROM */
@@ -61,6 +61,9 @@ static void dreams_reset (void)
 
 static int dreams_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(dreams_last_write);
+
    if (mmc_pattern_vram_in_use)
    {
       /* Mapper requires some CHR ROM */
@@ -58,6 +58,9 @@ static void ffe_f3_reset(void)
 
 static int ffe_f3_init(void)
 {
+    /* Each machine context has its own mapper state. */
+    MACHINE_REGISTER_STATE(ffe_f3_last_write);
+
     /* Mapper requires some CHR ROM */
     if(mmc_pattern_vram_in_use)
         return -1;
@@ -61,6 +61,9 @@ static void gnrom_reset (void)
 
 static int gnrom_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(gnrom_last_write);
+
    if (mmc_pattern_vram_in_use)
    {
       /* Mapper requires some CHR ROM */
@@ -258,6 +258,14 @@ static void mmc1_reset(void)
 
 static int mmc1_init(void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(mmc1_bit_stream);
+   MACHINE_REGISTER_STATE(mmc1_bit_counter);
+   MACHINE_REGISTER_STATE(mmc1_register);
+   MACHINE_REGISTER_STATE(mmc1_previous_register);
+   MACHINE_REGISTER_STATE(mmc1_256k_bank_num);
+   MACHINE_REGISTER_STATE(mmc1_cpu_bank);
+
    cpu_set_write_handler_32k(0x8000, mmc1_write);
 
    mmc1_reset();
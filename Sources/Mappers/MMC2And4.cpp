@@ -157,8 +157,19 @@ static void mmc2_reset(void)
 }
 
 
+/* Each machine context has its own mapper state. */
+static void mmc2and4_register_state(void)
+{
+   MACHINE_REGISTER_STATE(mmc2and4_prg_bank);
+   MACHINE_REGISTER_STATE(mmc2and4_vrom_bank);
+   MACHINE_REGISTER_STATE(mmc2and4_latch);
+   MACHINE_REGISTER_STATE(mmc2and4_rom_bank_size);
+}
+
 static int mmc2_init(void)
 {
+   mmc2and4_register_state();
+
    /* Mapper requires some CHR ROM */
    if(mmc_pattern_vram_in_use)
       return -1;
@@ -189,6 +200,8 @@ static void mmc4_reset(void)
 
 static int mmc4_init (void)
 {
+   mmc2and4_register_state();
+
    /* Mapper requires some CHR ROM */
    if(ROM_CHR_ROM_PAGES < 1)
       return -1;
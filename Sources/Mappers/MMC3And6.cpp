@@ -425,6 +425,20 @@ static void mmc3_reset(void)
 
 static int mmc3_init(void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(mmc3_command);
+   MACHINE_REGISTER_STATE(mmc3_prg_address);
+   MACHINE_REGISTER_STATE(mmc3_chr_address);
+   MACHINE_REGISTER_STATE(mmc3_prg_bank);
+   MACHINE_REGISTER_STATE(mmc3_chr_bank);
+   MACHINE_REGISTER_STATE(mmc3_irq_counter);
+   MACHINE_REGISTER_STATE(mmc3_irq_latch);
+   MACHINE_REGISTER_STATE(mmc3_disable_irqs);
+   MACHINE_REGISTER_STATE(mmc3_irq_bank);
+   MACHINE_REGISTER_STATE(mmc3_irq_queued);
+   MACHINE_REGISTER_STATE(mmc3_register_8000);
+   MACHINE_REGISTER_STATE(mmc3_sram_enable);
+
    cpu_set_write_handler_32k(0x8000, mmc3_write);
 
    mmc3_check_vram_banking();
@@ -1157,6 +1157,23 @@ static int mmc5_init (void)
 {
     int index;
 
+    /* Each machine context has its own mapper state. */
+    MACHINE_REGISTER_STATE(mmc5_filled_name_table_needs_update);
+    MACHINE_REGISTER_STATE(mmc5_5100);
+    MACHINE_REGISTER_STATE(mmc5_5200);
+    MACHINE_REGISTER_STATE(mmc5_multiply_result);
+    MACHINE_REGISTER_STATE(mmc5_multiply_needs_update);
+    MACHINE_REGISTER_STATE(mmc5_wram);
+    MACHINE_REGISTER_STATE(mmc5_exram);
+    MACHINE_REGISTER_STATE(mmc5_filled_name_table);
+    MACHINE_REGISTER_STATE(mmc5_wram_size);
+    MACHINE_REGISTER_STATE(mmc5_wram_lut);
+    MACHINE_REGISTER_STATE(background_patterns_last_mapped);
+    MACHINE_REGISTER_STATE(mmc5_irq_line_counter);
+    MACHINE_REGISTER_STATE(mmc5_irq_line_requested);
+    MACHINE_REGISTER_STATE(mmc5_irq_status);
+    MACHINE_REGISTER_STATE(mmc5_disable_irqs);
+
     /* Clear this once and always leave it that way - see the comments for it's declaration. */
     memset(mmc5_nxram, 0x00, sizeof(mmc5_nxram));
 
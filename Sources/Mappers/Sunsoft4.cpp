@@ -196,6 +196,12 @@ static void sunsoft4_reset (void)
 
 static int sunsoft4_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(sunsoft4_name_table_banks);
+   MACHINE_REGISTER_STATE(sunsoft4_name_table_control);
+   MACHINE_REGISTER_STATE(sunsoft4_prg_bank);
+   MACHINE_REGISTER_STATE(sunsoft4_chr_bank);
+
    if (mmc_pattern_vram_in_use)
    {
       /* Mapper requires some CHR ROM. */
@@ -42,6 +42,9 @@ static void unrom_reset (void)
 
 static int unrom_init (void)
 {
+   /* Each machine context has its own mapper state. */
+   MACHINE_REGISTER_STATE(unrom_last_write);
+
    /* No VROM hardware. */
    mmc_pattern_vram_in_use = TRUE;
 
@@ -405,6 +405,24 @@ static void vrc6_reset(void)
    apu_reset_exsound(APU_EXSOUND_VRC6);
 }
 
+/* Each machine context has its own mapper state. */
+static void vrc6_register_state (void)
+{
+   MACHINE_REGISTER_STATE(vrc6_swap_address_pins);
+   MACHINE_REGISTER_STATE(vrc6_prg_bank);
+   MACHINE_REGISTER_STATE(vrc6_chr_bank);
+   MACHINE_REGISTER_STATE(vrc6_clock_counter);
+   MACHINE_REGISTER_STATE(vrc6_clock_buffer);
+   MACHINE_REGISTER_STATE(vrc6_irq_timer);
+   MACHINE_REGISTER_STATE(vrc6_irq_step);
+   MACHINE_REGISTER_STATE(vrc6_irq_counter);
+   MACHINE_REGISTER_STATE(vrc6_irq_latch);
+   MACHINE_REGISTER_STATE(vrc6_irq_reg);
+   MACHINE_REGISTER_STATE(vrc6_enable_irqs);
+   MACHINE_REGISTER_STATE(vrc6_prediction_timestamp);
+   MACHINE_REGISTER_STATE(vrc6_prediction_cycles);
+}
+
 static int vrc6_base_init (void)
 {
    /* Install write handler. */
@@ -425,6 +443,8 @@ static int vrc6_base_init (void)
 
 static int vrc6_init (void)
 {
+   vrc6_register_state();
+
    /* Disable address pin swap. */
    vrc6_swap_address_pins = FALSE;
 
@@ -433,6 +453,8 @@ static int vrc6_init (void)
 
 static int vrc6v_init (void)
 {
+   vrc6_register_state();
+
    /* Pins A0 and A1 are swapped in VRC6V. */
    vrc6_swap_address_pins = TRUE;
 
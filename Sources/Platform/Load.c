@@ -37,6 +37,12 @@ const UDATA* load_file(const UDATA *filename)
 
    RT_ASSERT(filename);
 
+   /* Each machine context can have a different file loaded. */
+   MACHINE_REGISTER_STATE(global_rom);
+   MACHINE_REGISTER_STATE(nsf_is_loaded);
+   MACHINE_REGISTER_STATE(rom_is_loaded);
+   MACHINE_REGISTER_STATE(file_is_loaded);
+
    /* Attempt to intercept NSF file. */
    if(ustricmp(get_extension(filename), "NSF") == 0) {
       result = load_nsf_file(filename);
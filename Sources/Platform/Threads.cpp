@@ -0,0 +1,441 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifdef USE_HAWKTHREADS
+#include <hawkthreads.h>
+#endif
+#ifdef SYSTEM_POSIX
+#include <unistd.h>
+#endif
+#include "Log.h"
+#include "Threads.h"
+#include "Local.hpp"
+
+namespace {
+
+// Upper limit on the number of worker threads, not counting the main thread.
+const int MaximumWorkers = 7;
+
+#ifdef USE_HAWKTHREADS
+/* HawkThreads conditions don't remember being signalled while nobody was waiting on them, so idle
+   workers also wake up on their own this often (in milliseconds) to look for work. A missed wakeup
+   only means that the main thread ends up running more of the batch by itself. */
+const int WakeTimeout = 10;
+
+HThreadID workers[MaximumWorkers];
+HTmutex mutex;
+HTcond wake;
+#endif
+
+int workerCount = 0;
+
+// The batch currently being run. These are only accessed while holding the mutex.
+THREAD_JOB currentJob = NULL;
+void* currentData = NULL;
+int jobCount = 0, nextJob = 0, pendingJobs = 0;
+bool quit = false;
+
+} // namespace anonymous
+
+#ifdef USE_HAWKTHREADS
+struct _THREAD {
+   HThreadID id;
+   THREAD_FUNCTION function;
+   void* data;
+   //
+   HTmutex mutex;	// Guards the flags below.
+   HTcond wake;
+   bool woken, stop;
+};
+
+struct _THREAD_LOCK {
+   HTmutex mutex;
+};
+#endif
+
+/* Dedicated threads rely on atomic exchanges to share data without locking, so they are only
+   available when the compiler provides them. */
+#if defined(USE_HAWKTHREADS) && defined(__GNUC__)
+#define THREADS_DEDICATED
+#endif
+
+// Function prototypes (defined at bottom).
+static int GetProcessorCount();
+#ifdef USE_HAWKTHREADS
+static bool RunNextJob();
+static void* Worker(void* data);
+static void* Dedicated(void* data);
+#endif
+
+// --------------------------------------------------------------------------------
+
+void threads_init(void)
+{
+#ifdef USE_HAWKTHREADS
+   workerCount = 0;
+
+   // The main thread takes part in every batch, so it counts as one of the processors.
+   int count = GetProcessorCount() - 1;
+   if(count > MaximumWorkers)
+      count = MaximumWorkers;
+   if(count <= 0)
+      return;
+
+   if(htMutexInit(&mutex) != 0) {
+      log_printf("THREADS: Failed to create mutex, running single-threaded.\n");
+      return;
+   }
+
+   if(htCondInit(&wake) != 0) {
+      log_printf("THREADS: Failed to create condition, running single-threaded.\n");
+      htMutexDestroy(&mutex);
+      return;
+   }
+
+   quit = false;
+
+   for(int i = 0; i < count; i++) {
+      HThreadID thread = htThreadCreate(Worker, NULL, HT_TRUE);
+      if(!thread)
+         break;
+
+      workers[workerCount++] = thread;
+   }
+
+   if(workerCount == 0) {
+      htCondDestroy(&wake);
+      htMutexDestroy(&mutex);
+   }
+
+   log_printf("THREADS: Started %d worker thread(s).\n", workerCount);
+#endif
+}
+
+void threads_exit(void)
+{
+#ifdef USE_HAWKTHREADS
+   if(workerCount == 0)
+      return;
+
+   htMutexLock(&mutex);
+   quit = true;
+   htMutexUnlock(&mutex);
+
+   htCondBroadcast(&wake);
+
+   for(int i = 0; i < workerCount; i++)
+      htThreadJoin(workers[i], NULL);
+
+   workerCount = 0;
+
+   htCondDestroy(&wake);
+   htMutexDestroy(&mutex);
+#endif
+}
+
+// Returns how many threads a batch is spread across, including the main thread.
+int threads_get_count(void)
+{
+   return workerCount + 1;
+}
+
+void threads_run(THREAD_JOB job, void* data, const int count)
+{
+   Safeguard(job);
+
+#ifdef USE_HAWKTHREADS
+   if((workerCount > 0) && (count > 1)) {
+      htMutexLock(&mutex);
+      currentJob = job;
+      currentData = data;
+      jobCount = count;
+      nextJob = 0;
+      pendingJobs = count;
+      htMutexUnlock(&mutex);
+
+      htCondBroadcast(&wake);
+
+      // Help out with the batch, then wait for any jobs that are still running on the workers.
+      while(RunNextJob());
+
+      for(;;) {
+         htMutexLock(&mutex);
+         const bool finished = pendingJobs == 0;
+         htMutexUnlock(&mutex);
+
+         if(finished)
+            break;
+
+         htThreadYield();
+      }
+
+      htMutexLock(&mutex);
+      currentJob = NULL;
+      currentData = NULL;
+      jobCount = 0;
+      nextJob = 0;
+      htMutexUnlock(&mutex);
+
+      return;
+   }
+#endif
+
+   for(int i = 0; i < count; i++)
+      job(data, i);
+}
+
+THREAD* threads_start(THREAD_FUNCTION function, void* data)
+{
+   Safeguard(function);
+
+#ifdef THREADS_DEDICATED
+   THREAD* thread = new THREAD;
+   thread->function = function;
+   thread->data = data;
+   thread->woken = false;
+   thread->stop = false;
+
+   if(htMutexInit(&thread->mutex) != 0) {
+      delete thread;
+      return NULL;
+   }
+
+   if(htCondInit(&thread->wake) != 0) {
+      htMutexDestroy(&thread->mutex);
+      delete thread;
+      return NULL;
+   }
+
+   thread->id = htThreadCreate(Dedicated, thread, HT_TRUE);
+   if(!thread->id) {
+      htCondDestroy(&thread->wake);
+      htMutexDestroy(&thread->mutex);
+      delete thread;
+      return NULL;
+   }
+
+   return thread;
+#else
+   return NULL;
+#endif
+}
+
+void threads_stop(THREAD* thread)
+{
+   Safeguard(thread);
+
+#ifdef THREADS_DEDICATED
+   htMutexLock(&thread->mutex);
+   thread->stop = true;
+   htMutexUnlock(&thread->mutex);
+
+   threads_wake(thread);
+   htThreadJoin(thread->id, NULL);
+
+   htCondDestroy(&thread->wake);
+   htMutexDestroy(&thread->mutex);
+   delete thread;
+#endif
+}
+
+BOOL threads_should_stop(THREAD* thread)
+{
+   Safeguard(thread);
+
+#ifdef THREADS_DEDICATED
+   htMutexLock(&thread->mutex);
+   const bool stop = thread->stop;
+   htMutexUnlock(&thread->mutex);
+
+   return stop ? TRUE : FALSE;
+#else
+   return TRUE;
+#endif
+}
+
+void threads_wake(THREAD* thread)
+{
+   Safeguard(thread);
+
+#ifdef THREADS_DEDICATED
+   htMutexLock(&thread->mutex);
+   thread->woken = true;
+   htMutexUnlock(&thread->mutex);
+
+   htCondBroadcast(&thread->wake);
+#endif
+}
+
+void threads_sleep(THREAD* thread, const int timeout)
+{
+   Safeguard(thread);
+
+#ifdef THREADS_DEDICATED
+   // Don't bother waiting if a wakeup arrived while we were busy.
+   htMutexLock(&thread->mutex);
+   const bool woken = thread->woken;
+   thread->woken = false;
+   htMutexUnlock(&thread->mutex);
+
+   if(woken)
+      return;
+
+   htCondWait(&thread->wake, timeout);
+
+   htMutexLock(&thread->mutex);
+   thread->woken = false;
+   htMutexUnlock(&thread->mutex);
+#endif
+}
+
+THREAD_LOCK* threads_create_lock(void)
+{
+#ifdef THREADS_DEDICATED
+   THREAD_LOCK* lock = new THREAD_LOCK;
+   if(htMutexInit(&lock->mutex) != 0) {
+      delete lock;
+      return NULL;
+   }
+
+   return lock;
+#else
+   return NULL;
+#endif
+}
+
+void threads_destroy_lock(THREAD_LOCK* lock)
+{
+#ifdef THREADS_DEDICATED
+   if(lock) {
+      htMutexDestroy(&lock->mutex);
+      delete lock;
+   }
+#endif
+}
+
+void threads_lock(THREAD_LOCK* lock)
+{
+#ifdef THREADS_DEDICATED
+   if(lock)
+      htMutexLock(&lock->mutex);
+#endif
+}
+
+void threads_unlock(THREAD_LOCK* lock)
+{
+#ifdef THREADS_DEDICATED
+   if(lock)
+      htMutexUnlock(&lock->mutex);
+#endif
+}
+
+int threads_exchange(volatile int* target, const int value)
+{
+   Safeguard(target);
+
+#ifdef __GNUC__
+   // The compare-and-swap builtins are full barriers, unlike __sync_lock_test_and_set().
+   int previous;
+   do {
+      previous = *target;
+   } while(__sync_val_compare_and_swap(target, previous, value) != previous);
+
+   return previous;
+#else
+   // Without atomics there are no dedicated threads, so nothing else can be touching the value.
+   const int previous = *target;
+   *target = value;
+   return previous;
+#endif
+}
+
+int threads_add(volatile int* target, const int value)
+{
+   Safeguard(target);
+
+#ifdef __GNUC__
+   return __sync_add_and_fetch(target, value);
+#else
+   *target += value;
+   return *target;
+#endif
+}
+
+void threads_barrier(void)
+{
+#ifdef __GNUC__
+   __sync_synchronize();
+#endif
+}
+
+// --------------------------------------------------------------------------------
+
+static int GetProcessorCount()
+{
+#if defined(SYSTEM_POSIX) && defined(_SC_NPROCESSORS_ONLN)
+   const long count = sysconf(_SC_NPROCESSORS_ONLN);
+   if(count > 0)
+      return (int)count;
+#elif defined(SYSTEM_WINDOWS)
+   const char* count = getenv("NUMBER_OF_PROCESSORS");
+   if(count && (atoi(count) > 0))
+      return atoi(count);
+#endif
+
+   return 1;
+}
+
+#ifdef USE_HAWKTHREADS
+// Claims and runs the next job of the current batch. Returns false if there was nothing left to do.
+static bool RunNextJob()
+{
+   htMutexLock(&mutex);
+   if(nextJob >= jobCount) {
+      htMutexUnlock(&mutex);
+      return false;
+   }
+
+   const int index = nextJob++;
+   THREAD_JOB job = currentJob;
+   void* data = currentData;
+   htMutexUnlock(&mutex);
+
+   job(data, index);
+
+   htMutexLock(&mutex);
+   pendingJobs--;
+   htMutexUnlock(&mutex);
+
+   return true;
+}
+
+static void* Worker(void* data)
+{
+   for(;;) {
+      htMutexLock(&mutex);
+      const bool done = quit;
+      htMutexUnlock(&mutex);
+
+      if(done)
+         break;
+
+      if(!RunNextJob())
+         htCondWait(&wake, WakeTimeout);
+   }
+
+   return NULL;
+}
+
+// Entry point for dedicated threads, which just runs the thread's function.
+static void* Dedicated(void* data)
+{
+   THREAD* thread = (THREAD*)data;
+   thread->function(thread, thread->data);
+
+   return NULL;
+}
+#endif
@@ -0,0 +1,78 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifndef PLATFORM__THREADS_H__INCLUDED
+#define PLATFORM__THREADS_H__INCLUDED
+#include "Common/Global.h"
+#include "Common/Types.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A small pool of worker threads for splitting up work that can be done
+   in parallel, such as filtering a frame in horizontal bands.
+
+   A batch of jobs is started with threads_run(), which calls the job
+   function once for each index from 0 to count - 1, spread across the
+   workers and the calling thread, and returns once all of them have
+   finished. Jobs within a batch must not depend on each other.
+
+   Without thread support (or on a single processor), threads_run() simply
+   runs every job in order on the calling thread. Only one thread may start
+   batches at a time, and never from within a job. */
+typedef void (*THREAD_JOB)(void* data, const int index);
+
+extern void threads_init(void);
+extern void threads_exit(void);
+extern int threads_get_count(void);
+extern void threads_run(THREAD_JOB job, void* data, const int count);
+
+/* Dedicated threads, for work that runs alongside emulation rather than in
+   batches, such as presenting frames.
+
+   The thread function should return soon after threads_should_stop() becomes
+   TRUE, which happens when threads_stop() is called. threads_stop() waits for
+   the function to return. A thread can wait for threads_wake() with
+   threads_sleep(), which also returns after 'timeout' milliseconds, since
+   a wakeup can occasionally be missed.
+
+   Without thread support, threads_start() returns NULL and the caller has to
+   do the work itself. Locks work the same way, and passing a NULL lock to
+   threads_lock() or threads_unlock() does nothing. */
+typedef struct _THREAD THREAD;
+typedef struct _THREAD_LOCK THREAD_LOCK;
+typedef void (*THREAD_FUNCTION)(THREAD* thread, void* data);
+
+extern THREAD* threads_start(THREAD_FUNCTION function, void* data);
+extern void threads_stop(THREAD* thread);
+extern BOOL threads_should_stop(THREAD* thread);
+extern void threads_wake(THREAD* thread);
+extern void threads_sleep(THREAD* thread, const int timeout);
+
+extern THREAD_LOCK* threads_create_lock(void);
+extern void threads_destroy_lock(THREAD_LOCK* lock);
+extern void threads_lock(THREAD_LOCK* lock);
+extern void threads_unlock(THREAD_LOCK* lock);
+
+/* Stores a value and returns the one it replaced, as a single atomic step.
+   This is also a full memory barrier: anything written before the exchange is
+   visible to a thread that sees the new value. */
+extern int threads_exchange(volatile int* target, const int value);
+
+/* Adds to a value as a single atomic step, for counters that more than one
+   thread updates. Returns the new value. */
+extern int threads_add(volatile int* target, const int value);
+
+/* A full memory barrier on its own, for the reading side of data published
+   with threads_exchange(): after seeing the new value, a barrier makes sure
+   that nothing written before it is read stale. */
+extern void threads_barrier(void);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* !PLATFORM__THREADS_H__INCLUDED */
@@ -0,0 +1,624 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifdef SYSTEM_POSIX
+/* For clock_gettime(), which is hidden in strict C99 mode. */
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <allegro.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "apu.h"
+#include "audio.h"
+#include "benchmark.h"
+#include "common.h"
+#include "config.h"
+#include "cpu.h"
+#include "debug.h"
+#include "load.h"
+#include "log.h"
+#include "machine.h"
+#include "platform.h"
+#include "timing.h"
+#include "types.h"
+#include "video.h"
+
+#ifdef SYSTEM_WINDOWS
+#include <winalleg.h>
+#endif
+
+/* Frame-throughput benchmark. This runs the emulation loop unthrottled for a fixed number of
+   frames, once for each combination of CPU execution model and APU emulation mode, and reports
+   the frame rate along with the time spent in each section of the emulator.
+
+   Usage: --benchmark <file> <frames>
+
+   The display is initialized as normal so that video_update_display() is included, but audio
+   goes to the null driver so that output is never throttled by the sound card.
+
+   In the asynchronous model, the PPU and APU are clocked from inside the CPU core, so their
+   time is counted toward the CPU; timing every single clock would distort the results.
+
+   Afterwards, the CPU interrupt queue is timed on its own against the sorted list it replaced,
+   replaying the interrupt updates the PPU and APU make on each scanline, with and without
+   lookups of the next interrupt in between. Both are driven through the same calls, and the
+   results of every lookup are compared, so this doubles as a test of the queue. */
+
+/* Whether timing is currently being collected. */
+BOOL benchmark_active = FALSE;
+
+/* Maximum nesting depth of sections. This only has to be as deep as the call chains that
+   can enter them (e.g CPU -> PPU -> mapper). */
+#define MAX_DEPTH 16
+
+/* Scanlines replayed by the interrupt queue benchmark, and how many lookups of the next
+   interrupt are made during each one (roughly one per instruction). */
+#define INTERRUPT_LINES    1000000
+#define INTERRUPT_CHECKS   40
+
+/* Per-section totals, in ticks (see get_ticks()). */
+static double totals[BENCHMARK_SECTIONS];
+
+/* Stack of active sections. The bottom entry is always BENCHMARK_SECTION_OTHER. */
+static ENUM stack[MAX_DEPTH];
+static int depth = 0;
+
+/* Time at which the top of the stack last changed. */
+static double last_ticks = 0.0;
+
+static const char* section_names[BENCHMARK_SECTIONS] = {
+   "Other", "CPU", "PPU", "APU", "Mapper", "Video"
+};
+
+static const struct {
+   ENUM model;
+   const char* name;
+} models[] = {
+   { CPU_EXECUTION_MODEL_NORMAL,       "Normal" },
+   { CPU_EXECUTION_MODEL_FAST,         "Fast" },
+   { CPU_EXECUTION_MODEL_ASYNCHRONOUS, "Asynchronous" }
+};
+
+/* Reference copy of the CPU interrupt queue as it was before the core moved to a fixed slot for
+   each type of interrupt: a linked list kept sorted by priority (NMIs first) and then by time, with
+   a node allocated for every interrupt that is queued. */
+typedef struct _REFERENCE_INTERRUPT {
+   ENUM type;
+   cpu_time_t time;
+   struct _REFERENCE_INTERRUPT* next;
+} REFERENCE_INTERRUPT;
+
+static REFERENCE_INTERRUPT* reference_queue = NULL;
+/* Clock that the reference list is checked against, standing in for cpu_get_time(). */
+static cpu_time_t reference_time = 0;
+
+static const struct {
+   ENUM emulation;
+   const char* name;
+} apu_modes[] = {
+   { APU_EMULATION_FAST,         "Fast" },
+   { APU_EMULATION_ACCURATE,     "Accurate" },
+   { APU_EMULATION_HIGH_QUALITY, "High Quality" },
+   { APU_EMULATION_BAND_LIMITED, "Band-Limited" }
+};
+
+/* Function prototypes. */
+static double get_ticks(void);
+static double get_ticks_per_second(void);
+static void run(const long frames);
+static void run_interrupts(void);
+static unsigned long replay_interrupts(const BOOL reference, const long lines, const int checks);
+static long verify_interrupts(const long lines, const int checks);
+static void set_interrupt(const BOOL reference, const ENUM type, const cpu_time_t time);
+static void clear_interrupt(const BOOL reference, const ENUM type);
+static BOOL get_next_interrupt(const BOOL reference, cpu_time_t* time);
+static cpu_time_t get_time(const BOOL reference);
+static void burn(const BOOL reference, const cpu_time_t time);
+static void reference_set_interrupt(const ENUM type, const cpu_time_t time);
+static void reference_clear_interrupt(const ENUM type);
+static BOOL reference_get_next_interrupt(cpu_time_t* time);
+static void cleanup(void);
+
+int benchmark_main(int argc, char* argv[])
+{
+   const UDATA* error = NULL;
+   ENUM saved_model;
+   ENUM saved_emulation;
+   long frames;
+   int i, j;
+
+   if(argc < 3) {
+      fprintf(stderr, "Usage: --benchmark <file> <frames>\n");
+      return 1;
+   }
+
+   frames = strtol(argv[2], NULL, 10);
+   if(frames <= 0) {
+      fprintf(stderr, "Invalid frame count '%s'\n", argv[2]);
+      return 1;
+   }
+
+   allegro_init();
+   install_timer();
+
+   if(platform_init() != 0)
+      return 1;
+
+   /* Load the configuration, so that the video options match a normal run. It is never
+      saved, since the audio override below must not be persisted. */
+   load_config();
+
+   audio_options.enable_output = TRUE;
+   audio_options.subsystem = AUDIO_SUBSYSTEM_NONE;
+
+   if(audio_init() != 0) {
+      fprintf(stderr, "Failed to initialize audio\n");
+      cleanup();
+      return 1;
+   }
+
+   if(video_init() != 0) {
+      fprintf(stderr, "Failed to initialize video\n");
+      cleanup();
+      return 1;
+   }
+
+   error = load_file(argv[1]);
+   if(error) {
+      fprintf(stderr, "Unable to load file '%s': %s\n", argv[1], error);
+      cleanup();
+      return 1;
+   }
+
+   /* load_file() starts the timers for real-time emulation, which we don't use. */
+   machine_pause();
+
+   saved_model = cpu_get_execution_model();
+   saved_emulation = apu_options.emulation;
+
+   printf("%-13s %-13s %9s", "CPU", "APU", "FPS");
+   for(i = 0; i < BENCHMARK_SECTIONS; i++)
+      printf(" %8s", section_names[i]);
+   printf("\n");
+
+   for(i = 0; i < (int)(sizeof(models) / sizeof(models[0])); i++) {
+      for(j = 0; j < (int)(sizeof(apu_modes) / sizeof(apu_modes[0])); j++) {
+         cpu_set_execution_model(models[i].model);
+         apu_options.emulation = apu_modes[j].emulation;
+         apu_update();
+
+         printf("%-13s %-13s ", models[i].name, apu_modes[j].name);
+         fflush(stdout);
+
+         run(frames);
+      }
+   }
+
+   printf("\nSection times are in microseconds per frame.\n\n");
+
+   run_interrupts();
+
+   cpu_set_execution_model(saved_model);
+   apu_options.emulation = saved_emulation;
+
+   close_file();
+   cleanup();
+
+   return 0;
+}
+
+void benchmark_enter(const ENUM section)
+{
+   const double ticks = get_ticks();
+
+   totals[stack[depth]] += ticks - last_ticks;
+   last_ticks = ticks;
+
+   if(depth == (MAX_DEPTH - 1)) {
+      WARN_GENERIC();
+      return;
+   }
+
+   stack[++depth] = section;
+}
+
+void benchmark_leave(void)
+{
+   const double ticks = get_ticks();
+
+   totals[stack[depth]] += ticks - last_ticks;
+   last_ticks = ticks;
+
+   if(depth == 0) {
+      WARN_GENERIC();
+      return;
+   }
+
+   depth--;
+}
+
+/* ---------------------------------------------------------------------- */
+
+#if defined(SYSTEM_POSIX)
+
+static double get_ticks(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec * 1000000000.0) + now.tv_nsec;
+}
+
+static double get_ticks_per_second(void)
+{
+   return 1000000000.0;
+}
+
+#elif defined(SYSTEM_WINDOWS)
+
+static double get_ticks(void)
+{
+   LARGE_INTEGER now;
+   QueryPerformanceCounter(&now);
+   return (double)now.QuadPart;
+}
+
+static double get_ticks_per_second(void)
+{
+   LARGE_INTEGER frequency;
+   QueryPerformanceFrequency(&frequency);
+   return (double)frequency.QuadPart;
+}
+
+#else
+
+static double get_ticks(void)
+{
+   return (double)clock();
+}
+
+static double get_ticks_per_second(void)
+{
+   return (double)CLOCKS_PER_SEC;
+}
+
+#endif
+
+/* Runs a single pass from a freshly reset machine and prints its results. */
+static void run(const long frames)
+{
+   double start, elapsed;
+   long frame;
+   int i;
+
+   machine_reset();
+
+   for(i = 0; i < BENCHMARK_SECTIONS; i++)
+      totals[i] = 0.0;
+
+   depth = 0;
+   stack[0] = BENCHMARK_SECTION_OTHER;
+
+   benchmark_active = TRUE;
+   start = last_ticks = get_ticks();
+
+   for(frame = 0; frame < frames; frame++)
+      machine_execute_frame(TRUE);
+
+   /* Account for the tail end of the last frame. */
+   elapsed = get_ticks();
+   totals[BENCHMARK_SECTION_OTHER] += elapsed - last_ticks;
+   elapsed = (elapsed - start) / get_ticks_per_second();
+
+   benchmark_active = FALSE;
+
+   printf("%9.1f", (elapsed > 0.0) ? (frames / elapsed) : 0.0);
+   for(i = 0; i < BENCHMARK_SECTIONS; i++)
+      printf(" %8.1f", ((totals[i] / get_ticks_per_second()) * 1000000.0) / frames);
+   printf("\n");
+}
+
+/* Times the interrupt queue against the reference list, checks that the two agree and prints the
+   results. This is done in a machine context of its own, so that the CPU state is left alone. */
+static void run_interrupts(void)
+{
+   static const char* names[2] = { "List", "Core" };
+   MACHINE_CONTEXT* saved_context;
+   MACHINE_CONTEXT* context;
+   double times[2][2];
+   unsigned long sum = 0;
+   long mismatches;
+   int i, j;
+
+   saved_context = machine_get_context();
+
+   context = machine_create_context();
+   if(!context || (machine_select_context(context) != 0)) {
+      fprintf(stderr, "Failed to create a context for the interrupt queue benchmark\n");
+      if(context)
+         machine_destroy_context(context);
+
+      return;
+   }
+
+   for(i = 0; i < 2; i++) {
+      for(j = 0; j < 2; j++) {
+         const double start = get_ticks();
+
+         sum += replay_interrupts(i == 0, INTERRUPT_LINES, (j == 0) ? 0 : INTERRUPT_CHECKS);
+
+         times[i][j] = ((get_ticks() - start) / get_ticks_per_second()) * 1000000000.0;
+         times[i][j] /= INTERRUPT_LINES;
+      }
+   }
+
+   mismatches = verify_interrupts(INTERRUPT_LINES, INTERRUPT_CHECKS);
+
+   machine_select_context(saved_context);
+   machine_destroy_context(context);
+
+   printf("Interrupt queue, %d scanlines:\n", INTERRUPT_LINES);
+   printf("%-13s %9s %9s\n", "Queue", "Set/clear", "+Lookups");
+
+   for(i = 0; i < 2; i++)
+      printf("%-13s %9.1f %9.1f\n", names[i], times[i][0], times[i][1]);
+
+   printf("%-13s %8.1fx %8.1fx\n", "Speedup",
+      (times[1][0] > 0.0) ? (times[0][0] / times[1][0]) : 0.0,
+      (times[1][1] > 0.0) ? (times[0][1] / times[1][1]) : 0.0);
+
+   printf("\nQueue times are in nanoseconds per scanline (checksum %lu).\n", sum);
+
+   if(mismatches == 0)
+      printf("The queue agreed with the reference list in every lookup.\n");
+   else
+      printf("The queue disagreed with the reference list in %ld lookups!\n", mismatches);
+}
+
+/* Replays the interrupt updates that the PPU and APU make on each scanline - clearing every
+   predicted interrupt and queueing it again - on either the CPU's queue or the reference list,
+   with 'checks' lookups of the next interrupt spread over each line. Returns the sum of the times
+   found by the lookups, so that they can't be optimized away. */
+static unsigned long replay_interrupts(const BOOL reference, const long lines, const int checks)
+{
+   const cpu_time_t check_time = (checks > 0) ? (SCANLINE_CLOCKS / checks) : 0;
+   unsigned long sum = 0;
+   long line;
+   int i;
+
+   for(line = 0; line < lines; line++) {
+      const cpu_time_t now = get_time(reference);
+
+      clear_interrupt(reference, CPU_INTERRUPT_NMI);
+      clear_interrupt(reference, CPU_INTERRUPT_IRQ_MAPPER_PROXY);
+      clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_FRAME);
+      clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_DMC);
+
+      if((line % 262) == 241)
+         set_interrupt(reference, CPU_INTERRUPT_NMI, now + 100);
+      if((line % 7) == 0)
+         set_interrupt(reference, CPU_INTERRUPT_IRQ_MAPPER_PROXY, now + 300);
+
+      set_interrupt(reference, CPU_INTERRUPT_IRQ_APU_FRAME, now + 5000);
+      set_interrupt(reference, CPU_INTERRUPT_IRQ_APU_DMC, now + 9000);
+
+      for(i = 0; i < checks; i++) {
+         cpu_time_t time;
+
+         burn(reference, check_time);
+         if(get_next_interrupt(reference, &time))
+            sum += time;
+      }
+
+      burn(reference, (now + SCANLINE_CLOCKS) - get_time(reference));
+   }
+
+   /* Leave the queue empty. */
+   clear_interrupt(reference, CPU_INTERRUPT_NMI);
+   clear_interrupt(reference, CPU_INTERRUPT_IRQ_MAPPER_PROXY);
+   clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_FRAME);
+   clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_DMC);
+
+   return sum;
+}
+
+/* Makes the same updates as replay_interrupts() to both the CPU's queue and the reference list in
+   step, with the interrupt times varied from line to line, and returns how many lookups of the next
+   interrupt gave different results. */
+static long verify_interrupts(const long lines, const int checks)
+{
+   const cpu_time_t check_time = (checks > 0) ? (SCANLINE_CLOCKS / checks) : 0;
+   long mismatches = 0;
+   long line;
+   int i, j;
+
+   /* Start both clocks out the same. */
+   reference_time = cpu_get_time();
+
+   for(line = 0; line < lines; line++) {
+      const cpu_time_t now = cpu_get_time();
+      /* Spread the times over the line and the next one, so that interrupts are found both
+         before and after they have been reached, and in every order. */
+      const cpu_time_t offsets[4] = {
+         ((cpu_time_t)line * 97) % (SCANLINE_CLOCKS * 2),
+         ((cpu_time_t)line * 311) % (SCANLINE_CLOCKS * 2),
+         ((cpu_time_t)line * 1013) % (SCANLINE_CLOCKS * 2),
+         ((cpu_time_t)line * 4099) % (SCANLINE_CLOCKS * 2)
+      };
+
+      for(j = 0; j < 2; j++) {
+         const BOOL reference = (j == 0);
+
+         /* Only some of the interrupts are cleared each line, so that stale ones are left
+            queued as well. */
+         if((line % 3) != 0)
+            clear_interrupt(reference, CPU_INTERRUPT_NMI);
+         if((line % 5) != 0)
+            clear_interrupt(reference, CPU_INTERRUPT_IRQ_MAPPER_PROXY);
+         clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_FRAME);
+         clear_interrupt(reference, CPU_INTERRUPT_IRQ_APU_DMC);
+
+         if((line % 262) == 241)
+            set_interrupt(reference, CPU_INTERRUPT_NMI, now + offsets[0]);
+         if((line % 7) == 0)
+            set_interrupt(reference, CPU_INTERRUPT_IRQ_MAPPER_PROXY, now + offsets[1]);
+         if((line % 2) == 0)
+            set_interrupt(reference, CPU_INTERRUPT_IRQ_APU_FRAME, now + offsets[2]);
+
+         set_interrupt(reference, CPU_INTERRUPT_IRQ_APU_DMC, now + offsets[3]);
+      }
+
+      for(i = 0; i < checks; i++) {
+         cpu_time_t reference_next = 0, next = 0;
+         BOOL reference_found, found;
+
+         burn(TRUE, check_time);
+         burn(FALSE, check_time);
+
+         reference_found = get_next_interrupt(TRUE, &reference_next);
+         found = get_next_interrupt(FALSE, &next);
+
+         if((reference_found != found) || (found && (reference_next != next)))
+            mismatches++;
+      }
+   }
+
+   for(j = 0; j < 2; j++) {
+      clear_interrupt(j == 0, CPU_INTERRUPT_NMI);
+      clear_interrupt(j == 0, CPU_INTERRUPT_IRQ_MAPPER_PROXY);
+      clear_interrupt(j == 0, CPU_INTERRUPT_IRQ_APU_FRAME);
+      clear_interrupt(j == 0, CPU_INTERRUPT_IRQ_APU_DMC);
+   }
+
+   return mismatches;
+}
+
+/* These forward to either the CPU's interrupt API or to the reference list. */
+static void set_interrupt(const BOOL reference, const ENUM type, const cpu_time_t time)
+{
+   if(reference)
+      reference_set_interrupt(type, time);
+   else
+      cpu_set_interrupt(type, time);
+}
+
+static void clear_interrupt(const BOOL reference, const ENUM type)
+{
+   if(reference)
+      reference_clear_interrupt(type);
+   else
+      cpu_clear_interrupt(type);
+}
+
+static BOOL get_next_interrupt(const BOOL reference, cpu_time_t* time)
+{
+   if(reference)
+      return reference_get_next_interrupt(time);
+   else
+      return cpu_get_next_interrupt(time);
+}
+
+static cpu_time_t get_time(const BOOL reference)
+{
+   return reference ? reference_time : cpu_get_time();
+}
+
+static void burn(const BOOL reference, const cpu_time_t time)
+{
+   if(reference)
+      reference_time += time;
+   else
+      cpu_burn(time);
+}
+
+/* Queues an interrupt in the reference list. Like the CPU's queue, only the earliest interrupt of
+   each type is kept. */
+static void reference_set_interrupt(const ENUM type, const cpu_time_t time)
+{
+   const BOOL nmi = (type == CPU_INTERRUPT_NMI);
+   REFERENCE_INTERRUPT** link;
+   REFERENCE_INTERRUPT* interrupt;
+
+   for(link = &reference_queue; *link; link = &(*link)->next) {
+      if((*link)->type != type)
+         continue;
+
+      if(((cpu_rtime_t)(*link)->time - (cpu_rtime_t)time) <= 0)
+         return;
+
+      reference_clear_interrupt(type);
+      break;
+   }
+
+   interrupt = malloc(sizeof(REFERENCE_INTERRUPT));
+   if(!interrupt) {
+      WARN_GENERIC();
+      return;
+   }
+
+   interrupt->type = type;
+   interrupt->time = time;
+
+   /* Insert it after everything that sorts the same or before it, so that ties are kept in the
+      order they were queued in. */
+   for(link = &reference_queue; *link; link = &(*link)->next) {
+      const BOOL current_nmi = ((*link)->type == CPU_INTERRUPT_NMI);
+
+      if(nmi && !current_nmi)
+         break;
+      if((nmi == current_nmi) && (((cpu_rtime_t)(*link)->time - (cpu_rtime_t)time) > 0))
+         break;
+   }
+
+   interrupt->next = *link;
+   *link = interrupt;
+}
+
+static void reference_clear_interrupt(const ENUM type)
+{
+   REFERENCE_INTERRUPT** link = &reference_queue;
+
+   while(*link) {
+      REFERENCE_INTERRUPT* interrupt = *link;
+
+      if(interrupt->type == type) {
+         *link = interrupt->next;
+         free(interrupt);
+      }
+      else
+         link = &interrupt->next;
+   }
+}
+
+/* Like cpu_get_next_interrupt(), this finds the earliest interrupt that has not been reached yet.
+   As NMIs are sorted ahead of everything else, the whole list has to be searched. */
+static BOOL reference_get_next_interrupt(cpu_time_t* time)
+{
+   const REFERENCE_INTERRUPT* interrupt;
+   BOOL found = FALSE;
+
+   for(interrupt = reference_queue; interrupt; interrupt = interrupt->next) {
+      if(((cpu_rtime_t)reference_time - (cpu_rtime_t)interrupt->time) >= 0)
+         continue;
+
+      if(!found || (((cpu_rtime_t)interrupt->time - (cpu_rtime_t)*time) < 0)) {
+         *time = interrupt->time;
+         found = TRUE;
+      }
+   }
+
+   return found;
+}
+
+static void cleanup(void)
+{
+   video_exit();
+   audio_exit();
+
+   platform_exit();
+}
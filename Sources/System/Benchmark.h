@@ -0,0 +1,48 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifndef SYSTEM__BENCHMARK_H__INCLUDED
+#define SYSTEM__BENCHMARK_H__INCLUDED
+#include "Common/Global.h"
+#include "Common/Types.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Sections that time is accounted to. Sections nest, and time is only counted for the
+   innermost one, so e.g a PPU register write during cpu_execute() counts toward the PPU. */
+enum {
+   BENCHMARK_SECTION_OTHER = 0,
+   BENCHMARK_SECTION_CPU,
+   BENCHMARK_SECTION_PPU,
+   BENCHMARK_SECTION_APU,
+   BENCHMARK_SECTION_MAPPER,
+   BENCHMARK_SECTION_VIDEO,
+   BENCHMARK_SECTIONS
+};
+
+extern BOOL benchmark_active;
+
+extern int benchmark_main(int argc, char* argv[]);
+extern void benchmark_enter(const ENUM section);
+extern void benchmark_leave(void);
+
+/* These cost a single test when not benchmarking. */
+#define BENCHMARK_ENTER(_SECTION) do { \
+   if(benchmark_active) \
+      benchmark_enter((_SECTION)); \
+} while(0)
+
+#define BENCHMARK_LEAVE() do { \
+   if(benchmark_active) \
+      benchmark_leave(); \
+} while(0)
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* !SYSTEM__BENCHMARK_H__INCLUDED */
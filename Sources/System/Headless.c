@@ -0,0 +1,250 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#include <allegro.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "audio.h"
+#include "common.h"
+#include "config.h"
+#include "debug.h"
+#include "headless.h"
+#include "load.h"
+#include "log.h"
+#include "machine.h"
+#include "platform.h"
+#include "toolkit/md5.h"
+#include "types.h"
+#include "video.h"
+
+/* Headless batch runner. This loads a file, emulates a fixed number of frames as fast as
+   possible with no display, no audio device and no throttling, then writes hashes of the
+   rendered frames and of the generated audio so that runs can be compared against each other.
+
+   Usage: <file> <frames> [output] [consoles]
+
+   With more than one console, the file is loaded into a separate machine context for each,
+   and the consoles are run a frame at a time in turn. Their video is hashed separately, so
+   matching hashes show that the contexts don't leak into one another. The audio of all of
+   the consoles goes through the one output, and so is hashed together. An output of "-"
+   writes to the standard output.
+
+   Allegro is still used for its utility functions, but no system driver is installed. */
+
+#define MAX_CONSOLES	64
+
+/* Running hashes of everything that was rendered and output. */
+static md5_t video_md5[MAX_CONSOLES];
+static md5_t audio_md5;
+
+/* Machine context of each console, the first being the default context. */
+static MACHINE_CONTEXT* contexts[MAX_CONSOLES];
+static int console_count = 0;
+
+/* Function prototypes. */
+static void hash_audio(const void* buffer, const unsigned size);
+static void hash_frame(const int console);
+static void close_consoles(void);
+static void cleanup(void);
+
+int headless_main(int argc, char* argv[])
+{
+   const UDATA* error = NULL;
+   long frames, frame;
+   long consoles;
+   clock_t start, elapsed;
+   UINT8 signature[MD5_SIZE];
+   char hex[MD5_HEX_SIZE];
+   FILE* output;
+   int i;
+
+   if(argc < 3) {
+      fprintf(stderr, "Usage: %s <file> <frames> [output] [consoles]\n", argv[0]);
+      return 1;
+   }
+
+   frames = strtol(argv[2], NULL, 10);
+   if(frames <= 0) {
+      fprintf(stderr, "Invalid frame count '%s'\n", argv[2]);
+      return 1;
+   }
+
+   consoles = 1;
+   if(argc >= 5) {
+      consoles = strtol(argv[4], NULL, 10);
+      if((consoles < 1) || (consoles > MAX_CONSOLES)) {
+         fprintf(stderr, "Invalid console count '%s' (1-%d)\n", argv[4], MAX_CONSOLES);
+         return 1;
+      }
+   }
+
+   /* Initialize Allegro without a system driver, so that nothing is ever opened on the host. */
+   if(install_allegro(SYSTEM_NONE, &errno, atexit) != 0) {
+      fprintf(stderr, "Failed to initialize Allegro\n");
+      return 1;
+   }
+
+   if(platform_init() != 0)
+      return 1;
+
+   /* The configuration is loaded so that palette and emulation options match a normal run,
+      but it is never saved, since the overrides below must not be persisted. */
+   load_config();
+
+   for(i = 0; i < consoles; i++)
+      md5_init(&video_md5[i]);
+
+   md5_init(&audio_md5);
+
+   /* Route audio into the null driver, which passes every buffer it is given to us. */
+   audio_options.enable_output = TRUE;
+   audio_options.subsystem = AUDIO_SUBSYSTEM_NONE;
+   audio_null_output = hash_audio;
+
+   if(audio_init() != 0) {
+      fprintf(stderr, "Failed to initialize audio\n");
+      cleanup();
+      return 1;
+   }
+
+   if(video_init_headless() != 0) {
+      fprintf(stderr, "Failed to initialize video\n");
+      cleanup();
+      return 1;
+   }
+
+   for(i = 0; i < consoles; i++) {
+      if(i == 0) {
+         contexts[i] = machine_get_context();
+      }
+      else {
+         contexts[i] = machine_create_context();
+         if(!contexts[i] || (machine_select_context(contexts[i]) != 0)) {
+            fprintf(stderr, "Failed to create a context for console %d\n", i + 1);
+            if(contexts[i])
+               machine_destroy_context(contexts[i]);
+
+            close_consoles();
+            cleanup();
+            return 1;
+         }
+      }
+
+      console_count++;
+
+      error = load_file(argv[1]);
+      if(error) {
+         fprintf(stderr, "Unable to load file '%s': %s\n", argv[1], error);
+         close_consoles();
+         cleanup();
+         return 1;
+      }
+
+      /* load_file() starts the timers for real-time emulation, which we don't use. */
+      machine_pause();
+   }
+
+   start = clock();
+
+   for(frame = 0; frame < frames; frame++) {
+      for(i = 0; i < console_count; i++) {
+         /* Selecting the current context is free, so a single console costs nothing extra. */
+         machine_select_context(contexts[i]);
+         machine_execute_frame(TRUE);
+         /* The render buffer is shared by all of the consoles, so it must be hashed before
+            the next one draws over it. */
+         hash_frame(i);
+      }
+   }
+
+   elapsed = clock() - start;
+
+   output = stdout;
+   if((argc >= 4) && (strcmp(argv[3], "-") != 0)) {
+      output = fopen(argv[3], "w");
+      if(!output) {
+         perror(argv[3]);
+         close_consoles();
+         cleanup();
+         return 1;
+      }
+   }
+
+   fprintf(output, "frames: %ld\n", frames);
+
+   for(i = 0; i < console_count; i++) {
+      md5_finish(&video_md5[i], signature);
+      md5_sig_to_string(signature, hex, sizeof(hex));
+
+      if(console_count == 1)
+         fprintf(output, "video: %s\n", hex);
+      else
+         fprintf(output, "video %d: %s\n", i + 1, hex);
+   }
+
+   md5_finish(&audio_md5, signature);
+   md5_sig_to_string(signature, hex, sizeof(hex));
+   fprintf(output, "audio: %s\n", hex);
+
+   if(output != stdout)
+      fclose(output);
+
+   fprintf(stderr, "%ld frames in %.3f seconds (%.1f FPS)\n", frames * console_count,
+      (double)elapsed / CLOCKS_PER_SEC,
+      elapsed > 0 ? (double)(frames * console_count) / ((double)elapsed / CLOCKS_PER_SEC) : 0.0);
+
+   close_consoles();
+   cleanup();
+
+   return 0;
+}
+
+/* ---------------------------------------------------------------------- */
+
+static void hash_audio(const void* buffer, const unsigned size)
+{
+   md5_process(&audio_md5, buffer, size);
+}
+
+static void hash_frame(const int console)
+{
+   BITMAP* bitmap = video_get_render_buffer();
+   const int pitch = bitmap->w * BYTES_PER_PIXEL(bitmap_color_depth(bitmap));
+   int y;
+
+   /* Lines are hashed one at a time since the bitmap may be padded. */
+   for(y = 0; y < bitmap->h; y++)
+      md5_process(&video_md5[console], bitmap->line[y], pitch);
+}
+
+/* Closes the file loaded into each console, and destroys all but the default context. */
+static void close_consoles(void)
+{
+   int i;
+
+   for(i = console_count - 1; i >= 0; i--) {
+      machine_select_context(contexts[i]);
+      if(file_is_loaded)
+         close_file();
+   }
+
+   for(i = 1; i < console_count; i++)
+      machine_destroy_context(contexts[i]);
+
+   console_count = 0;
+}
+
+static void cleanup(void)
+{
+   video_exit();
+   audio_exit();
+
+   platform_exit();
+}
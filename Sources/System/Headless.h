@@ -0,0 +1,21 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifndef SYSTEM__HEADLESS_H__INCLUDED
+#define SYSTEM__HEADLESS_H__INCLUDED
+#include "Common/Global.h"
+#include "Common/Types.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern int headless_main(int argc, char* argv[]);
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* !SYSTEM__HEADLESS_H__INCLUDED */
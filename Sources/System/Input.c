@@ -16,6 +16,7 @@
 #include "debug.h"
 #include "gui.h"
 #include "input.h"
+#include "machine.h"
 #include "netplay.h"
 #include "ppu.h"
 #include "rom.h"
@@ -478,6 +479,13 @@ void input_reset (void)
 {
    int player;
 
+   /* The controller ports belong to the machine context. Button states come from the host,
+      so are shared. */
+   MACHINE_REGISTER_STATE (zapper_mask);
+   MACHINE_REGISTER_STATE (last_write);
+   MACHINE_REGISTER_STATE (current_read_p1);
+   MACHINE_REGISTER_STATE (current_read_p2);
+
    /* Reset button states. */
 
    for (player = 0; player < INPUT_PLAYERS; player++)
@@ -743,7 +751,9 @@ void input_update_zapper (void)
       if(buffer) {
          int r, g, b;
 
-         pixel = _getpixel16(buffer, input_zapper_x_offset, input_zapper_y_offset);
+         /* With raw output (for the NTSC blitter) the buffer holds palette indices rather than
+            colors, which the PPU has to map back first. */
+         pixel = ppu_unmap_color(_getpixel16(buffer, input_zapper_x_offset, input_zapper_y_offset));
          color_unpack_16(pixel, &r, &g, &b);
          
          /* Check for white. */
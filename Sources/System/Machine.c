@@ -13,6 +13,7 @@
 #include <string.h>
 #include "apu.h"
 #include "audio.h"
+#include "benchmark.h"
 #include "common.h"
 #include "cpu.h"
 #include "gui.h"
@@ -63,6 +64,9 @@ int timing_fps = 0;
 int timing_hertz = 0;
 int timing_audio_fps = 0;
 
+/* Number of CPU cycles skipped by idle loop skipping during the last frame. */
+int timing_skipped_cycles = 0;
+
 /* Timing clock (in milliseconds). Actual accuracy varies depending on the machine type
    and speed modifiers (NTSC gives a base accuracy of about 16ms). */
 UINT32 timing_clock = 0;
@@ -90,6 +94,7 @@ int rendered_frames = 0;
 static int actual_fps_count = 0;
 static int virtual_fps_count = 0;
 static int frame_count = 1;
+static cpu_time_t skipped_time = 0;
 /* Note: These need to be marked volatile so they won't crash. */
 static volatile BOOL frame_interrupt = FALSE;
 static volatile int throttle_counter = 0;
@@ -103,6 +108,38 @@ static volatile int key_names[KEY_BUFFER_MAX];
 static volatile int key_codes[KEY_BUFFER_MAX];
 static volatile int key_buffer_size = 0;
 
+/* Machine contexts. The state of the virtual machine is kept in globals spread throughout
+   the CPU, PPU, APU and mapper code. Rather than passing a pointer through all of them,
+   each component registers the globals that belong to a single console when it is
+   initialized, using MACHINE_REGISTER_STATE(). A context holds a private copy of each of
+   those, which machine_select_context() swaps in and out of the globals.
+
+   Only the selected context is live, so all contexts must be driven from the same thread,
+   and a context must never be selected from within machine_main() or any of the components.
+   Swapping copies every registered global, so this is best done once per frame at most.
+   Configuration (including cheats and the like) is shared by all contexts. */
+#define MACHINE_STATES_MAX	512
+
+typedef struct _MACHINE_STATE {
+   void* data;		/* Registered global. */
+   size_t size;		/* Size of the global, in bytes. */
+   void* initial;	/* Contents of the global when it was registered. */
+} MACHINE_STATE;
+
+struct _MACHINE_CONTEXT {
+   /* Copy of each registered global while the context is not selected. These are
+      allocated when the context is first switched away from, and if a copy doesn't
+      exist yet (e.g the context is new), the initial contents are used instead. */
+   void* copies[MACHINE_STATES_MAX];
+};
+
+static MACHINE_STATE machine_states[MACHINE_STATES_MAX];
+static int machine_state_count = 0;
+
+/* The context used until another is selected, which always exists. */
+static MACHINE_CONTEXT default_context;
+static MACHINE_CONTEXT* current_context = &default_context;
+
 /* Function prototypes. */
 static void fps_timer(void);
 static void throttle_timer(void);
@@ -110,6 +147,7 @@ static int keyboard_handler(int key, int* scancode);
 
 static UINT8 read_registers(const UINT16 address);
 static void write_registers(const UINT16 address, const UINT8 data);
+static void register_state(void);
 
 void machine_load_config(void)
 {
@@ -144,6 +182,9 @@ int machine_init(void)
       return 1;
    }
 
+   /* Make our own state part of the current context. */
+   register_state();
+
    /* Determine machine type from the region. */
    timing_update_machine_type();
 
@@ -365,6 +406,13 @@ void machine_main(void)
          frame_count = frame_skip;
    }
 
+   /* When frames are shown on a separate thread, drawing them no longer holds up emulation, so
+      falling behind the timer isn't a reason to skip them. Instead, automatic frame skip only skips
+      a frame when the presentation thread hasn't picked up the last one yet, as it would never be
+      seen anyway. The timer still decides when to throttle. */
+   if((frame_skip == -1) && video_is_threaded())
+      redraw = !video_is_busy();
+
    /* Handle real-time game rewinding. This essentially replaces the remainder of the
       emulation loop with a simple save state load. With save states getting loaded
       often enough, it appears as though gameplay is going backwards in time. */
@@ -387,11 +435,31 @@ void machine_main(void)
       }
    }
 
+   /* Game input processing is handled here. This is a bit different from general input
+      processing, which runs as often as possible. Game input processing expects to
+      only occur once per frame, locked to the machine's frame rate. */
+   input_process();
+
    /* At this point, we've performed general input processing, synchronized the frame
       timing and collected the neccessary information for frame skipping. So all we
       have left to do is emulate a single frame and return. */
-   executed_frames++;
    virtual_fps_count++;
+   if(redraw)
+      actual_fps_count++;
+
+   machine_execute_frame(redraw);
+
+   /* If CPU usage is not set to aggressive, yield the timeslice. */
+   if(cpu_usage != CPU_USAGE_AGGRESSIVE)
+      rest(0);
+}
+
+/* Emulates a single frame, with none of the input processing, throttling or yielding done
+   by machine_main(), so that frames can be run back to back as fast as possible (e.g when
+   running without a display). The frame is only drawn if 'redraw' is TRUE. */
+void machine_execute_frame(const BOOL redraw)
+{
+   executed_frames++;
 
    /* Adjust the timing and game clocks. */
    timing_clock_delta += 1000 / timing_get_base_frame_rate();
@@ -417,16 +485,10 @@ void machine_main(void)
       game_clock_days++;
    }
 
-   /* Game input processing is handled here. This is a bit different from general input
-      processing, which runs as often as possible. Game input processing expects to
-      only occur once per frame, locked to the machine's frame rate. */
-   input_process();
-
    /* Check if we are frame skipping, or not. */
    if(redraw) {
       /* This frame will be drawn. */
       rendered_frames++;
-      actual_fps_count++;
 
       /* Enable PPU rendering. */
       ppu_set_option(PPU_OPTION_ENABLE_RENDERING, TRUE);
@@ -455,7 +517,10 @@ void machine_main(void)
          nsf_execute(SCANLINE_CLOCKS);
 
          apu_predict_irqs(SCANLINE_CLOCKS);
+
+         BENCHMARK_ENTER(BENCHMARK_SECTION_CPU);
          cpu_execute(SCANLINE_CLOCKS);
+         BENCHMARK_LEAVE();
 
          apu_sync_update();
       }
@@ -463,18 +528,60 @@ void machine_main(void)
       nsf_end_frame();
    }
    else {
-      /* Execute a scanline at a time, waiting for the PPU to complete a frame. Note that this
+      /* Execute the CPU in bursts, waiting for the PPU to complete a frame. Note that this
          just means the PPU completes a single frame, it does not account for when the frame
-         was completed or how long the PPU continues running afterwards. */
+         was completed or how long the PPU continues running afterwards.
+
+         Each burst runs until the end of the frame or until the next interrupt predicted by
+         any of the devices, whichever comes first. Mappers with scanline counters can only
+         predict a single scanline ahead, so they limit bursts to a scanline at a time. */
       while(!frame_lock) {
-         apu_predict_irqs(SCANLINE_CLOCKS);
+         cpu_time_t burst, window, next;
 
-         if(mmc_predict_asynchronous_irqs)
-            mmc_predict_asynchronous_irqs(SCANLINE_CLOCKS);
+         burst = ppu_get_frame_time_remaining();
+         if(mmc_virtual_scanline_start || mmc_virtual_hblank_start ||
+            mmc_virtual_hblank_prefetch_start) {
+            if(burst > SCANLINE_CLOCKS)
+               burst = SCANLINE_CLOCKS;
+         }
 
-         ppu_predict_interrupts(SCANLINE_CLOCKS, PPU_PREDICT_ALL);
+         /* Always make some progress, e.g if the frame is ending on this very clock. */
+         if(burst == 0)
+            burst = CPU_CLOCK_MULTIPLIER;
 
-         cpu_execute(SCANLINE_CLOCKS);
+         /* Predict far enough ahead to cover the burst being extended past an interrupt. */
+         window = burst + PREDICTION_MARGIN_CYCLES;
+
+         BENCHMARK_ENTER(BENCHMARK_SECTION_APU);
+         apu_predict_irqs(window);
+         BENCHMARK_LEAVE();
+
+         if(mmc_predict_asynchronous_irqs) {
+            BENCHMARK_ENTER(BENCHMARK_SECTION_MAPPER);
+            mmc_predict_asynchronous_irqs(window);
+            BENCHMARK_LEAVE();
+         }
+
+         BENCHMARK_ENTER(BENCHMARK_SECTION_PPU);
+         ppu_predict_interrupts(window, PPU_PREDICT_ALL);
+         BENCHMARK_LEAVE();
+
+         /* Stop shortly after the first interrupt, so that it has been taken by the time the
+            devices predict their interrupts again. */
+         if(cpu_get_next_interrupt(&next)) {
+            const cpu_time_t until = (cpu_rtime_t)next - (cpu_rtime_t)cpu_get_time();
+            if(until < burst)
+               burst = until + PREDICTION_MARGIN_CYCLES;
+         }
+
+         /* Idle loops polling the PPU status register mustn't be skipped past a change to it,
+            which can only happen once the current scanline has ended. */
+         if(cpu_get_idle_skipping())
+            cpu_set_idle_line_end(cpu_get_time() + ppu_get_line_time_remaining());
+
+         BENCHMARK_ENTER(BENCHMARK_SECTION_CPU);
+         cpu_execute(burst);
+         BENCHMARK_LEAVE();
  
          apu_sync_update();
          ppu_sync_update();
@@ -484,9 +591,9 @@ void machine_main(void)
       frame_lock = FALSE;
    }
 
-   /* If CPU usage is not set to aggressive, yield the timeslice. */
-   if(cpu_usage != CPU_USAGE_AGGRESSIVE)
-      rest(0);
+   /* Update the count of skipped cycles (the counter wraps, so take the difference). */
+   timing_skipped_cycles = (cpu_get_skipped_time() - skipped_time) / CPU_CLOCK_MULTIPLIER;
+   skipped_time = cpu_get_skipped_time();
 }
 
 /* Pauses the emulation, both timing and audio output. */
@@ -541,6 +648,128 @@ void machine_load_state(PACKFILE* file, const int version)
    game_clock_days = pack_igetw(file);
 }
 
+/* Creates a new machine context, which has no file loaded. Call machine_select_context() to
+   make it current, after which a file can be loaded and emulated as normal. */
+MACHINE_CONTEXT* machine_create_context(void)
+{
+   MACHINE_CONTEXT* context;
+
+   context = malloc(sizeof(MACHINE_CONTEXT));
+   if(!context) {
+      WARN("Failed to allocate memory for a machine context");
+      return NULL;
+   }
+
+   memset(context, 0, sizeof(MACHINE_CONTEXT));
+
+   return context;
+}
+
+/* Destroys a machine context. The context must not be selected, and any file loaded into
+   it must have been closed beforehand (by selecting it and calling close_file()). */
+void machine_destroy_context(MACHINE_CONTEXT* context)
+{
+   int i;
+
+   RT_ASSERT(context);
+
+   if((context == current_context) || (context == &default_context)) {
+      WARN("machine_destroy_context() called on the current or default context");
+      return;
+   }
+
+   for(i = 0; i < MACHINE_STATES_MAX; i++) {
+      if(context->copies[i])
+         free(context->copies[i]);
+   }
+
+   free(context);
+}
+
+/* Makes a machine context current. The state of the previous context is saved, and
+   that of the new context restored in its place. Returns nonzero on failure, in which
+   case the previous context remains current. */
+int machine_select_context(MACHINE_CONTEXT* context)
+{
+   int i;
+
+   RT_ASSERT(context);
+
+   if(context == current_context)
+      return 0;
+
+   /* Make sure there is somewhere to save everything to before touching anything, so
+      that a failure can't leave the state of the two contexts mixed up. */
+   for(i = 0; i < machine_state_count; i++) {
+      if(current_context->copies[i])
+         continue;
+
+      current_context->copies[i] = malloc(machine_states[i].size);
+      if(!current_context->copies[i]) {
+         WARN("Failed to allocate memory for a machine context");
+         return 1;
+      }
+   }
+
+   for(i = 0; i < machine_state_count; i++) {
+      const MACHINE_STATE* state = &machine_states[i];
+      const void* saved = context->copies[i];
+
+      memcpy(current_context->copies[i], state->data, state->size);
+      memcpy(state->data, saved ? saved : state->initial, state->size);
+   }
+
+   current_context = context;
+
+   return 0;
+}
+
+/* Returns the current machine context. */
+MACHINE_CONTEXT* machine_get_context(void)
+{
+   return current_context;
+}
+
+/* Adds a global to the state that is saved and restored with each context. This should
+   be done before the global is first modified (i.e, at the top of an init function),
+   as its contents at this point are what new contexts start out with. Registering the
+   same global more than once does nothing. Returns nonzero on failure. */
+int machine_register_state(void* data, const size_t size)
+{
+   MACHINE_STATE* state;
+   int i;
+
+   RT_ASSERT(data);
+   RT_ASSERT(size > 0);
+
+   for(i = 0; i < machine_state_count; i++) {
+      if(machine_states[i].data == data)
+         return 0;
+   }
+
+   if(machine_state_count >= MACHINE_STATES_MAX) {
+      WARN("Too many globals registered as machine state");
+      return 1;
+   }
+
+   state = &machine_states[machine_state_count];
+
+   state->initial = malloc(size);
+   if(!state->initial) {
+      WARN("Failed to allocate memory for machine state");
+      return 1;
+   }
+
+   memcpy(state->initial, data, size);
+
+   state->data = data;
+   state->size = size;
+
+   machine_state_count++;
+
+   return 0;
+}
+
 /* This is similar to Allegro's clear_keybuf(), but clears our custom keyboard buffer.
    This is called by the GUI before it closes in order to prevent the emulation loop from
    immediately re-opening it again. */
@@ -606,6 +835,25 @@ void resume_timing(void)
 
 /* -------------------------------------------------------------------------------- */
 
+/* Registers the parts of our state that belong to the emulated console, as opposed to
+   the host (e.g frame rate counters and the throttle). */
+static void register_state(void)
+{
+   MACHINE_REGISTER_STATE(machine_type);
+   MACHINE_REGISTER_STATE(timing_skipped_cycles);
+   MACHINE_REGISTER_STATE(timing_clock);
+   MACHINE_REGISTER_STATE(timing_clock_delta);
+   MACHINE_REGISTER_STATE(game_clock_milliseconds);
+   MACHINE_REGISTER_STATE(game_clock_seconds);
+   MACHINE_REGISTER_STATE(game_clock_minutes);
+   MACHINE_REGISTER_STATE(game_clock_hours);
+   MACHINE_REGISTER_STATE(game_clock_days);
+   MACHINE_REGISTER_STATE(frame_lock);
+   MACHINE_REGISTER_STATE(executed_frames);
+   MACHINE_REGISTER_STATE(rendered_frames);
+   MACHINE_REGISTER_STATE(skipped_time);
+}
+
 /* Allegro timer routines. */
 static void fps_timer(void)
 {
@@ -48,6 +48,13 @@ enum {
    TIMING_MODE_INDIRECT
 };
 
+/* Machine contexts, each of which holds the state of a separate console. */
+typedef struct _MACHINE_CONTEXT MACHINE_CONTEXT;
+
+/* Registers a global (or array) as part of the state held by each context. */
+#define MACHINE_REGISTER_STATE(_VARIABLE) \
+   machine_register_state((void*)&(_VARIABLE), sizeof(_VARIABLE))
+
 extern ENUM machine_region;
 extern ENUM machine_type;
 extern ENUM machine_timing;
@@ -60,6 +67,7 @@ extern int frame_skip;
 extern int timing_fps;
 extern int timing_hertz;
 extern int timing_audio_fps;
+extern int timing_skipped_cycles;
 
 extern ENUM timing_mode;
 extern REAL timing_speed_multiplier;
@@ -85,10 +93,16 @@ extern int machine_init(void);
 extern void machine_exit(void);
 extern void machine_reset(void);
 extern void machine_main(void);
+extern void machine_execute_frame(const BOOL redraw);
 extern void machine_pause(void);
 extern void machine_resume(void);
 extern void machine_save_state(FILE_CONTEXT* file, const int version);
 extern void machine_load_state(FILE_CONTEXT* file, const int version);
+extern MACHINE_CONTEXT* machine_create_context(void);
+extern void machine_destroy_context(MACHINE_CONTEXT* context);
+extern int machine_select_context(MACHINE_CONTEXT* context);
+extern MACHINE_CONTEXT* machine_get_context(void);
+extern int machine_register_state(void* data, const size_t size);
 extern void machine_clear_key_buffer(void);
 extern void machine_reset_game_clock(void);
 extern void suspend_timing(void);
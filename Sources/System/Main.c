@@ -8,10 +8,12 @@
 
 #include <allegro.h>
 #include "audio.h"
+#include "benchmark.h"
 #include "common.h"
 #include "config.h"
 #include "debug.h"
 #include "gui.h"
+#include "headless.h"
 #include "input.h"
 #include "load.h"
 #include "log.h"
@@ -20,6 +22,7 @@
 #include "net.h"
 #include "netplay.h"
 #include "platform.h"
+#include "threads.h"
 #include "types.h"
 #include "version.h"
 #include "video.h"
@@ -41,6 +44,15 @@ int main(int argc, char *argv[])
 {
    int result;
 
+#ifdef HEADLESS
+   /* Batch runs bypass the normal startup and main loop entirely. */
+   return headless_main(argc, argv);
+#endif
+
+   /* Benchmarks also bypass the normal startup, and don't want the banner in their output. */
+   if((argc >= 2) && (ustrcmp(argv[1], "--benchmark") == 0))
+      return benchmark_main(argc - 1, argv + 1);
+
    /* Clear the console. */
    console_clear();
 
@@ -90,6 +102,9 @@ int main(int argc, char *argv[])
    /* Load the configuration. */
    load_config();
 
+   /* Start the worker threads used by the video filters. */
+   threads_init();
+
    /* Initialize the GUI. */
    gui_preinit();
 
@@ -230,5 +245,6 @@ static void cleanup(void)
 
    save_config();
 
+   threads_exit();
    platform_exit();
 }
@@ -68,6 +68,24 @@ int mmc_controls_mirroring(void)
 
 static const MMC *current_mmc = NULL;
 
+static void register_state (void)
+{
+    /* Each machine context has its own mapper. */
+    MACHINE_REGISTER_STATE (mmc_scanline_start);
+    MACHINE_REGISTER_STATE (mmc_hblank_start);
+    MACHINE_REGISTER_STATE (mmc_hblank_prefetch_start);
+    MACHINE_REGISTER_STATE (mmc_virtual_scanline_start);
+    MACHINE_REGISTER_STATE (mmc_virtual_hblank_start);
+    MACHINE_REGISTER_STATE (mmc_virtual_hblank_prefetch_start);
+    MACHINE_REGISTER_STATE (mmc_predict_asynchronous_irqs);
+    MACHINE_REGISTER_STATE (mmc_check_vram_banking);
+    MACHINE_REGISTER_STATE (mmc_check_address_lines);
+    MACHINE_REGISTER_STATE (mmc_name_table_count);
+    MACHINE_REGISTER_STATE (mmc_pattern_vram_in_use);
+    MACHINE_REGISTER_STATE (mmc_fixed_mirroring);
+    MACHINE_REGISTER_STATE (current_mmc);
+}
+
 #define MMC_FIRST_LIST_ITEM(id)     \
     if (mmc_ ##id.number == mapper_number)       \
         current_mmc = &mmc_ ##id
@@ -81,6 +99,8 @@ static const MMC *current_mmc = NULL;
 
 void mmc_request (const int mapper_number)
 {
+    register_state ();
+
     MMC_FIRST_LIST_ITEM (none);     /* No mapper. */
 
     /* Nintendo MMCs. */
@@ -110,6 +130,8 @@ void mmc_force (const MMC *mmc)
 {
    /* Like mmc_request(), but forces a mapper without requiring a mapper number. */
 
+   register_state ();
+
    current_mmc = mmc;
 }
 
@@ -117,6 +139,8 @@ int mmc_init (void)
 {
     int index;
 
+    register_state ();
+
     for (index = 0x8000; index < (64 << 10); index += (8 << 10))
     {
         cpu_set_write_address_8k (index, dummy_write);
@@ -389,6 +389,11 @@ void nsf_end_frame(void)
       nsfAudioVisualizationData = null;
    }
 
+   /* The PPU never finishes a frame during NSF playback, so its options have to be applied here.
+      Otherwise the color map used below would not follow switches to and from raw output, which
+      the NTSC blitter expects the render buffer to hold. */
+   ppu_update_options();
+
    // Check if we are drawing, for frame skipping.
    if(!ppu_get_option(PPU_OPTION_ENABLE_RENDERING))
       return;
@@ -11,6 +11,7 @@
 #include <string.h>
 #include "common.h"
 #include "debug.h"
+#include "machine.h"
 #include "rewind.h"
 #include "save.h"
 #include "shared/bufferfile.h"
@@ -139,6 +140,10 @@ void rewind_save_config (void)
 
 int rewind_init (void)
 {
+   /* Each machine context rewinds through its own frames. */
+   MACHINE_REGISTER_STATE (queue);
+   MACHINE_REGISTER_STATE (wait_frames);
+
    /* Clear everything. */
    rewind_clear ();
 
@@ -75,6 +75,10 @@ extern "C" {
    always execute more than requested. */
 #define PREDICTION_BUFFER_CYCLES (8 * CPU_CLOCK_MULTIPLIER) /* 8 = Maximum cycle length of a 6502 opcode. */
 
+/* How far the CPU is run past a predicted interrupt before predicting again. Interrupts are only
+   taken at the start of an instruction, and re-prediction discards any that are still queued. */
+#define PREDICTION_MARGIN_CYCLES (PREDICTION_BUFFER_CYCLES + (1 * CPU_CLOCK_MULTIPLIER))
+
 /* -------------------------------------------------------------------------------- */
 
 extern REAL timing_get_timing_scale(void);
@@ -10,6 +10,13 @@
 #include "Local.hpp"
 #include "Renderer.hpp"
 
+// The line renderer can convert pixels to framebuffer values using SIMD when available.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
 // TODO: MMC5 ExRAM and attribute support.
 
 namespace Renderer {
@@ -111,6 +118,26 @@ force_inline void Postlogic()
    background.highFeed <<= 1;
 }
 
+/* Moves the VRAM address to the next column, inverting the horizontal name table bit if we wrap around
+   to zero. This allows us to move to the next horizontal name table seamlessly. */
+force_inline void NextColumn()
+{
+   int x = ppu__vram_address & _00011111b;
+   const int y = (ppu__vram_address >> 5) & _00011111b;
+   const int row = (ppu__vram_address >> 12) & _00000111b;
+   unsigned bit10 = (ppu__vram_address >> 10) & 1;
+   const unsigned bit11 = (ppu__vram_address >> 11) & 1;
+
+   x++;
+   if(x > 31) {
+      x = 0;
+      bit10 ^= 1;
+   }
+
+   // Update VRAM address.
+   ppu__vram_address = (row << 12) | (bit11 << 11) | (bit10 << 10) | (y << 5) | x;
+}
+
 /* This function just performs minimal logic for the background.
    It's used when frame skipping. */
 force_inline void Logic()
@@ -133,6 +160,7 @@ R_LookupTable( SequenceTable );
 void Initialize()
 {
    Clear();
+   FlushCache();
 
    // Clear lookup tables.
    R_ClearLookupTable( FetchTable );
@@ -185,6 +213,229 @@ void Line()
       rather ugly off-by-one error near the end of the first tile, but luckily it is easy to
       compensate for while still keeping our efficient flow-control. */
    background.counter++;
+
+   // Each line starts out being drawn a pixel at a time, until RenderLine() says otherwise.
+   background.batched = false;
+}
+
+namespace {
+
+/* Tile cache:
+      This holds pattern table rows that have already been decoded into 2-bit pixels (leftmost
+      first), for use by RenderLine(). Entries are keyed by the address of the 1k pattern table
+      page they were decoded from, so bank switching doesn't invalidate anything. Only writes to
+      the pattern tables do, via InvalidateTile(). Tiles are decoded as they are first used. */
+const int TileCacheEntries = 16;
+const int TileCacheTiles   = PPU__PATTERN_TABLE_PAGE_SIZE / 16;	// 16 bytes per tile
+const int TileCacheRows    = 8;
+
+typedef struct _TileCacheEntry {
+   const uint8* source;				// Pattern table page
+   bool decoded[TileCacheTiles];		// Set for each tile that has been decoded
+   uint8 rows[TileCacheTiles][TileCacheRows][8];	// Decoded pixels
+
+} TileCacheEntry;
+
+TileCacheEntry tileCache[TileCacheEntries];
+
+force_inline void DecodeRow(const uint8 low, const uint8 high, uint8* pixels)
+{
+   for(int i = 0; i < 8; i++) {
+      const int shifts = 7 - i;
+      pixels[i] = ((low >> shifts) & 1) | (((high >> shifts) & 1) << 1);
+   }
+}
+
+force_inline TileCacheEntry& GetTileCacheEntry(const uint8* page)
+{
+   return tileCache[((size_type)page / PPU__PATTERN_TABLE_PAGE_SIZE) % TileCacheEntries];
+}
+
+// Returns the decoded row of a tile, where 'offset' is the address of the row within the page.
+force_inline const uint8* GetTileRow(const uint8* page, const unsigned offset)
+{
+   TileCacheEntry& entry = GetTileCacheEntry(page);
+   if(entry.source != page) {
+      // Evict whatever page was here before.
+      entry.source = page;
+      memset(entry.decoded, 0, sizeof(entry.decoded));
+   }
+
+   const unsigned tile = offset / BytesPerTile;
+   if(!entry.decoded[tile]) {
+      const uint8* data = page + (tile * BytesPerTile);
+      for(int row = 0; row < TileCacheRows; row++)
+         DecodeRow(data[row], data[row + (BytesPerTile / 2)], entry.rows[tile][row]);
+
+      entry.decoded[tile] = true;
+   }
+
+   return entry.rows[tile][offset % BytesPerTile];
+}
+
+/* This converts a line of 4-bit palette entries (palette * 4 + pixel) into framebuffer values
+   using a 16-entry color table, while also filling the background scanline buffer with the
+   2-bit pixel values. As there are only 16 possible colors on a line of background, the color
+   table lookup maps onto a byte shuffle, so the framebuffer can be filled 16 or 32 pixels at a time. */
+force_inline void MapLine(const uint8* entries, const uint16* colors, uint16* output, uint8* pixels)
+{
+#if defined(__AVX2__) || defined(__SSSE3__)
+   // Split the color table into its low and high bytes, as the shuffle operates on bytes.
+   uint8 lowBytes[16], highBytes[16];
+   for(int i = 0; i < 16; i++) {
+      lowBytes[i] = colors[i] & 0xFF;
+      highBytes[i] = colors[i] >> 8;
+   }
+#endif
+
+#if defined(__AVX2__)
+   const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)lowBytes));
+   const __m256i highTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)highBytes));
+   const __m256i mask = _mm256_set1_epi8(_00000011b);
+
+   for(int i = 0; i < PPU_RENDER_CLOCKS; i += 32) {
+      const __m256i entry = _mm256_loadu_si256((const __m256i*)&entries[i]);
+      const __m256i low = _mm256_shuffle_epi8(lowTable, entry);
+      const __m256i high = _mm256_shuffle_epi8(highTable, entry);
+
+      // Unpacking works within each 128-bit half, so the halves have to be put back in order.
+      const __m256i first = _mm256_unpacklo_epi8(low, high);
+      const __m256i second = _mm256_unpackhi_epi8(low, high);
+      _mm256_storeu_si256((__m256i*)&output[i], _mm256_permute2x128_si256(first, second, 0x20));
+      _mm256_storeu_si256((__m256i*)&output[i + 16], _mm256_permute2x128_si256(first, second, 0x31));
+
+      _mm256_storeu_si256((__m256i*)&pixels[i], _mm256_and_si256(entry, mask));
+   }
+#elif defined(__SSSE3__)
+   const __m128i lowTable = _mm_loadu_si128((const __m128i*)lowBytes);
+   const __m128i highTable = _mm_loadu_si128((const __m128i*)highBytes);
+   const __m128i mask = _mm_set1_epi8(_00000011b);
+
+   for(int i = 0; i < PPU_RENDER_CLOCKS; i += 16) {
+      const __m128i entry = _mm_loadu_si128((const __m128i*)&entries[i]);
+      const __m128i low = _mm_shuffle_epi8(lowTable, entry);
+      const __m128i high = _mm_shuffle_epi8(highTable, entry);
+
+      _mm_storeu_si128((__m128i*)&output[i], _mm_unpacklo_epi8(low, high));
+      _mm_storeu_si128((__m128i*)&output[i + 8], _mm_unpackhi_epi8(low, high));
+
+      _mm_storeu_si128((__m128i*)&pixels[i], _mm_and_si128(entry, mask));
+   }
+#else
+   for(int i = 0; i < PPU_RENDER_CLOCKS; i++) {
+      const unsigned entry = entries[i];
+      output[i] = colors[entry];
+      pixels[i] = entry & _00000011b;
+   }
+#endif
+}
+
+} // namespace anonymous
+
+void RegisterState()
+{
+   MACHINE_REGISTER_STATE(tileCache);
+}
+
+// This discards the whole tile cache, e.g when a state has been loaded.
+void FlushCache()
+{
+   memset(tileCache, 0, sizeof(tileCache));
+}
+
+// This must be called whenever a byte in a pattern table page is written to.
+void InvalidateTile(const uint8* page, const unsigned offset)
+{
+   TileCacheEntry& entry = GetTileCacheEntry(page);
+   if(entry.source == page)
+      entry.decoded[(offset & PPU__PATTERN_TABLE_PAGE_MASK) / BytesPerTile] = false;
+}
+
+/* This draws the background for an entire line at once, and is called in place of the first
+   call to Pixel() on a line. The result is the same as if Pixel() were called for each of the
+   256 pixels, provided that nothing affecting the background changes during the line. If
+   something does, Renderer::Invalidate() clears 'batched' and Pixel() redraws the rest of
+   the line from that point on. Clock() still runs every cycle regardless, so that the VRAM
+   address and mapper hooks behave as usual. */
+void RenderLine()
+{
+   // Number of tiles that can be visible on a line, as fine scrolling exposes part of an extra one.
+   const int Tiles = (PPU_RENDER_CLOCKS / 8) + 1;
+   uint8 pixels[Tiles * 8];
+   uint8 palettes[Tiles];
+
+   /* The first two tiles were prefetched during HBlank of the previous line, and are already in
+      the shift registers and attribute latches. */
+   DecodeRow(background.lowShift, background.highShift, &pixels[0]);
+   palettes[0] = (background.buffer >> background.bufferTag) & AttributeMask;
+   DecodeRow(background.lowFeed, background.highFeed, &pixels[8]);
+   palettes[1] = (background.latch >> background.latchTag) & AttributeMask;
+
+   /* The rest are fetched during the line starting from the current VRAM address, exactly like
+      Clock() does, except that the VRAM address itself is left alone. */
+   const int row = (ppu__vram_address >> 12) & _00000111b;
+   const int y = (ppu__vram_address >> 5) & _00011111b;
+   int x = ppu__vram_address & _00011111b;
+   int table = (ppu__vram_address >> 10) & 3;
+
+   for(int tile = 2; tile < Tiles; tile++) {
+      const uint8* data = ppu__name_tables_read[table];
+      const unsigned name = data[(y << 5) | x];
+
+      const int attributeX = x / 4;
+      const int attributeY = ((y * TileHeight) + row) / 32;
+      const unsigned attribute = data[AttributeBase + (attributeY * (DisplayWidth / 32)) + attributeX];
+      const int shifts = (x & 2) | ((y & 2) << 1);
+      palettes[tile] = (attribute >> shifts) & AttributeMask;
+
+      const unsigned address = (name * BytesPerTile) + ppu__background_tileset + row;
+      const uint8* page = ppu__background_pattern_tables_read[address / PPU__PATTERN_TABLE_PAGE_SIZE];
+      memcpy(&pixels[tile * 8], GetTileRow(page, address & PPU__PATTERN_TABLE_PAGE_MASK), 8);
+
+      // Move to the next column, switching horizontal name tables when wrapping around.
+      x++;
+      if(x > 31) {
+         x = 0;
+         table ^= 1;
+      }
+   }
+
+   /* Attach the palette to each pixel to form a palette entry. Transparent pixels are left as
+      entry zero, which is the backdrop color regardless of palette. */
+   for(int tile = 0; tile < Tiles; tile++) {
+      uint8* row = &pixels[tile * 8];
+      const uint8 bits = palettes[tile] << 2;
+      for(int i = 0; i < 8; i++)
+         row[i] |= (row[i] != 0) ? bits : 0;
+   }
+
+   uint8* entries = &pixels[ppu__fine_scroll];
+
+   // Clipped pixels are transparent, as in Pixel().
+   if(ppu__clip_background)
+      memset(entries, 0, 8);
+
+   // Nothing can change the palettes for the duration of the line, so look them all up now.
+   uint16 colors[PPU__BACKGROUND_PALETTE_COUNT * PPU__BYTES_PER_PALETTE];
+   for(int palette = 0; palette < PPU__BACKGROUND_PALETTE_COUNT; palette++) {
+      for(int index = 0; index < PPU__BYTES_PER_PALETTE; index++)
+         colors[(palette * PPU__BYTES_PER_PALETTE) + index] = PPU__BACKGROUND_PALETTE(palette, index);
+   }
+
+   if(ppu__enable_background_layer)
+      MapLine(entries, colors, render.buffer, ppu__background_pixels);
+   else {
+      // Only the backdrop is drawn when the background layer is hidden.
+      for(int i = 0; i < PPU_RENDER_CLOCKS; i++) {
+         const int pixel = entries[i] & _00000011b;
+         PPU__PUT_BACKGROUND_PIXEL(i, pixel);
+
+         if(pixel == 0)
+            render.buffer[i] = colors[0];
+      }
+   }
+
+   background.batched = true;
 }
 
 #endif
@@ -258,6 +509,14 @@ force_inline void Pixel(const bool rendering)
    R_PutFramePixel( PPU__BACKGROUND_PALETTE(palette, pixel) );
 }
 
+/* This function is called in place of Pixel() once RenderLine() has drawn the line. The shift
+   registers still have to be clocked, in case the rest of the line has to be drawn by Pixel()
+   after all. */
+force_inline void PixelBatched()
+{
+   Logic();
+}
+
 // This function is called when the background is disabled.
 force_inline void PixelStub(const bool rendering)
 {
@@ -331,7 +590,17 @@ force_inline void Clock()
          // Disabled as this might cause problems with MMC3 games with the IRQ tied to A12.
          // if(render.line < PPU_FIRST_DISPLAYED_LINE)
          //    return;
-       
+
+         /* When frame skipping, nothing fetched here is ever drawn, so unless a mapper is watching
+            the address lines, only the VRAM address has to be kept up to date. */
+         if(ppu__minimal_frame_skip && !mmc_check_address_lines &&
+            !(ppu__enable_rendering || ppu__force_rendering)) {
+            if(SequenceTable[cycle] == 2)
+               NextColumn();
+
+            return;
+         }
+
          break;
 
       case Fetch_Always:
@@ -375,7 +644,7 @@ force_inline void Clock()
       case 2: {
          // Fetch attribute byte. This is also when the VRAM address is updated.
          const int table = (ppu__vram_address >> 10) & 3;
-         int x = ppu__vram_address & _00011111b;
+         const int x = ppu__vram_address & _00011111b;
          const int y = (ppu__vram_address >> 5) & _00011111b;
          const int row = (ppu__vram_address >> 12) & _00000111b;
 
@@ -401,23 +670,10 @@ force_inline void Clock()
             We can get the same behavior simply by ORing the masked bits together. =) */
          evaluation.tag = (x & 2) | ((y & 2) << 1);
 
-         // Unpack the rest of the VRAM address.
-         unsigned bit10 = (ppu__vram_address >> 10) & 1;
-         const unsigned bit11 = (ppu__vram_address >> 11) & 1;
-
          // We need to set this here so that the pattern data fetches can get at it.
          evaluation.row = row;
 
-         /* Move to the next column, inverting the horizontal name table bit if we wrap around to zero.
-            This allows us to move to the next horizontal name table seamlessly. */
-         x++;
-         if(x > 31) {
-            x = 0;
-            bit10 ^= 1;
-         }
-
-         // Update VRAM address.
-         ppu__vram_address = (row << 12) | (bit11 << 11) | (bit10 << 10) | (y << 5) | x;
+         NextColumn();
       }
 
       case 3:
@@ -19,7 +19,12 @@ extern R_LookupTable( SequenceTable );
 extern void Initialize();
 extern void Frame();
 extern void Line();
+extern void RegisterState();
+extern void FlushCache();
+extern void InvalidateTile(const uint8* page, const unsigned offset);
+extern void RenderLine();
 extern void Pixel(const bool rendering);
+extern void PixelBatched();
 extern void PixelStub(const bool rendering);
 extern void Clock();
 
@@ -21,7 +21,6 @@
 
 UINT32   HQX_LUT16to32[65536];
 UINT32   HQX_RGBtoYUV[65536];
-static int   YUV1, YUV2;
 static const  int   Ymask = 0x00FF0000;
 static const  int   Umask = 0x0000FF00;
 static const  int   Vmask = 0x000000FF;
@@ -50,17 +49,17 @@ void HQX_Initialize()
   }
 }
 
-express_function constant_function void Interp1(unsigned char * pc, const int c1, const int c2)
+express_function void Interp1(unsigned char * pc, const int c1, const int c2)
 {
   *((int*)pc) = (c1*3+c2) >> 2;
 }
 
-express_function constant_function void Interp2(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp2(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   *((int*)pc) = (c1*2+c2+c3) >> 2;
 }
 
-express_function constant_function void Interp3(unsigned char * pc, const int c1, const int c2)
+express_function void Interp3(unsigned char * pc, const int c1, const int c2)
 {
   //*((int*)pc) = (c1*7+c2)/8;
 
@@ -68,7 +67,7 @@ express_function constant_function void Interp3(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*7 + (c2 & 0xFF00FF) ) & 0x07F807F8)) >> 3;
 }
 
-express_function constant_function void Interp4(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp4(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   //*((int*)pc) = (c1*2+(c2+c3)*7)/16;
 
@@ -76,12 +75,12 @@ express_function constant_function void Interp4(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*2 + ((c2 & 0xFF00FF) + (c3 & 0xFF00FF))*7 ) & 0x0FF00FF0)) >> 4;
 }
 
-express_function constant_function void Interp5(unsigned char * pc, const int c1, const int c2)
+express_function void Interp5(unsigned char * pc, const int c1, const int c2)
 {
   *((int*)pc) = (c1+c2) >> 1;
 }
 
-express_function constant_function void Interp6(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp6(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   //*((int*)pc) = (c1*5+c2*2+c3)/8;
 
@@ -89,7 +88,7 @@ express_function constant_function void Interp6(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*5 + (c2 & 0xFF00FF)*2 + (c3 & 0xFF00FF) ) & 0x07F807F8)) >> 3;
 }
 
-express_function constant_function void Interp7(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp7(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   //*((int*)pc) = (c1*6+c2+c3)/8;
 
@@ -97,7 +96,7 @@ express_function constant_function void Interp7(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*6 + (c2 & 0xFF00FF) + (c3 & 0xFF00FF) ) & 0x07F807F8)) >> 3;
 }
 
-express_function constant_function void Interp8(unsigned char * pc, const int c1, const int c2)
+express_function void Interp8(unsigned char * pc, const int c1, const int c2)
 {
   //*((int*)pc) = (c1*5+c2*3)/8;
 
@@ -105,7 +104,7 @@ express_function constant_function void Interp8(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*5 + (c2 & 0xFF00FF)*3 ) & 0x07F807F8)) >> 3;
 }
 
-express_function constant_function void Interp9(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp9(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   //*((int*)pc) = (c1*2+(c2+c3)*3)/8;
 
@@ -113,7 +112,7 @@ express_function constant_function void Interp9(unsigned char * pc, const int c1
                  (((c1 & 0xFF00FF)*2 + ((c2 & 0xFF00FF) + (c3 & 0xFF00FF))*3 ) & 0x07F807F8)) >> 3;
 }
 
-express_function constant_function void Interp10(unsigned char * pc, const int c1, const int c2, const int c3)
+express_function void Interp10(unsigned char * pc, const int c1, const int c2, const int c3)
 {
   //*((int*)pc) = (c1*14+c2+c3)/16;
 
@@ -123,8 +122,8 @@ express_function constant_function void Interp10(unsigned char * pc, const int c
 
 express_function pure_function bool Diff(const unsigned int w1, const unsigned int w2)
 {
-  YUV1 = HQX_RGBtoYUV[w1];
-  YUV2 = HQX_RGBtoYUV[w2];
+  const int YUV1 = HQX_RGBtoYUV[w1];
+  const int YUV2 = HQX_RGBtoYUV[w2];
   return ( ( abs((YUV1 & Ymask) - (YUV2 & Ymask)) > trY ) ||
            ( abs((YUV1 & Umask) - (YUV2 & Umask)) > trU ) ||
            ( abs((YUV1 & Vmask) - (YUV2 & Vmask)) > trV ) );
@@ -374,10 +373,11 @@ express_function pure_function bool Diff(const unsigned int w1, const unsigned i
 #define HQ4X_PIXEL33_81    Interp8(pOut+BpL+BpL+BpL+12, c[5], c[6]);
 #define HQ4X_PIXEL33_82    Interp8(pOut+BpL+BpL+BpL+12, c[5], c[8]);
 
-void hq2x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+void hq2x_rows( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL, const int first, const int last )
 {
   int  i, j, k;
   int  prevline, nextline;
+  int  YUV1, YUV2;
   int  w[10];
   int  c[10];
 
@@ -392,7 +392,12 @@ void hq2x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  // Rows are independent of each other apart from reading their neighbours, so a range of rows
+  // can be filtered on its own by skipping ahead to the first one.
+  pIn += first * Xres * 2;
+  pOut += first * 2 * BpL;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
@@ -3101,10 +3106,11 @@ void hq2x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
   }
 }
 
-void hq3x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+void hq3x_rows( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL, const int first, const int last )
 {
   int  i, j, k;
   int  prevline, nextline;
+  int  YUV1, YUV2;
   int  w[10];
   int  c[10];
 
@@ -3119,7 +3125,12 @@ void hq3x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  // Rows are independent of each other apart from reading their neighbours, so a range of rows
+  // can be filtered on its own by skipping ahead to the first one.
+  pIn += first * Xres * 2;
+  pOut += first * 3 * BpL;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
@@ -6802,10 +6813,11 @@ void hq3x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
   }
 }
 
-void hq4x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+void hq4x_rows( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL, const int first, const int last )
 {
   int  i, j, k;
   int  prevline, nextline;
+  int  YUV1, YUV2;
   int  w[10];
   int  c[10];
 
@@ -6820,7 +6832,12 @@ void hq4x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
   //   | w7 | w8 | w9 |
   //   +----+----+----+
 
-  for (j=0; j<Yres; j++)
+  // Rows are independent of each other apart from reading their neighbours, so a range of rows
+  // can be filtered on its own by skipping ahead to the first one.
+  pIn += first * Xres * 2;
+  pOut += first * 4 * BpL;
+
+  for (j=first; j<last; j++)
   {
     if (j>0)      prevline = -Xres*2; else prevline = 0;
     if (j<Yres-1) nextline =  Xres*2; else nextline = 0;
@@ -11862,3 +11879,18 @@ void hq4x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int
     pOut+=BpL;
   }
 }
+
+void hq2x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+{
+  hq2x_rows(pIn, pOut, Xres, Yres, BpL, 0, Yres);
+}
+
+void hq3x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+{
+  hq3x_rows(pIn, pOut, Xres, Yres, BpL, 0, Yres);
+}
+
+void hq4x( unsigned char * pIn, unsigned char * pOut, const int Xres, const int Yres, const int BpL )
+{
+  hq4x_rows(pIn, pOut, Xres, Yres, BpL, 0, Yres);
+}
@@ -16,6 +16,11 @@ extern void hq2x(unsigned char* pIn, unsigned char* pOut, const int Xres, const
 extern void hq3x(unsigned char* pIn, unsigned char* pOut, const int Xres, const int Yres, const int BpL);
 extern void hq4x(unsigned char* pIn, unsigned char* pOut, const int Xres, const int Yres, const int BpL);
 
+// These filter only the input rows [first, last) of a frame, for splitting the work up into bands.
+extern void hq2x_rows(unsigned char* pIn, unsigned char* pOut, const int Xres, const int Yres, const int BpL, const int first, const int last);
+extern void hq3x_rows(unsigned char* pIn, unsigned char* pOut, const int Xres, const int Yres, const int BpL, const int first, const int last);
+extern void hq4x_rows(unsigned char* pIn, unsigned char* pOut, const int Xres, const int Yres, const int BpL, const int first, const int last);
+
 // We should probably extern these since they are assembly.
 extern "C" {
 
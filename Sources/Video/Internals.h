@@ -85,6 +85,10 @@ extern BOOL   ppu__enable_rendering;
 extern BOOL   ppu__enable_sprite_back_layer;
 extern BOOL   ppu__enable_sprite_front_layer;
 extern BOOL   ppu__force_rendering;
+extern BOOL   ppu__batch_background;
+extern BOOL   ppu__batch_sprites;
+extern BOOL   ppu__minimal_frame_skip;
+extern BOOL   ppu__raw_output;
 
 /* ****************************************************
    ********** NAME TABLES AND PATTERN TABLES **********
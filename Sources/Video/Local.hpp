@@ -33,6 +33,7 @@
 #include "Platform/Load.h"
 #include "Platform/Log.h"
 #include "Platform/Platform.h"
+#include "System/Benchmark.h"
 #include "System/Input.h"
 #include "System/Mapper.h"
 #include "System/Machine.h"
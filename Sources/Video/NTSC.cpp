@@ -4,6 +4,7 @@
 
 #include "Local.hpp"
 #include "NTSC.hpp"
+#include "Platform/Threads.h"
 
 /* Based on algorithm by NewRisingSun */
 /* Copyright (C) 2006 Shay Green. This module is free software; you
@@ -232,7 +233,7 @@ typedef struct pixel_info_t
 	(1.0f - (((ntsc) + 100) & 2))
 
 /* Generate pixel at all burst phases and column alignments */
-static void gen_kernel( struct ntsc_impl_t* impl, float y, float i, float q, ntsc_rgb_t* out )
+static void gen_kernel( struct ntsc_impl_t const* impl, float y, float i, float q, ntsc_rgb_t* out )
 {
 	/* generate for each scanline burst phase */
 	float const* to_rgb = impl->to_rgb [0];
@@ -349,58 +350,70 @@ static void correct_errors( ntsc_rgb_t color, ntsc_rgb_t* out )
 }
 /* end common code */
 
-void ntsc_init( ntsc_t* ntsc, ntsc_setup_t const* setup )
+/* Palette entries are generated in parallel, this many at a time. */
+enum { init_block_size = 32 };
+
+typedef struct init_job_t
 {
-	float to_float [32];
-	int entry;
-	struct ntsc_impl_t impl;
-	if ( !setup )
-		setup = &ntsc_composite;
-	init_ntsc_impl( &impl, setup );
-	
-	{
-		double gamma = 1 - setup->gamma * (setup->gamma > 0 ? 0.5f : 1.5f);
-		int i;
-		for ( i = 0; i < 32; i++ )
-			to_float [i] = (float) pow( (1 / 31.0) * i, gamma ) * rgb_unit;
-	}
+	ntsc_t* ntsc;
+	struct ntsc_impl_t const* impl;
+	ntsc_setup_t const* setup;
+	unsigned char const* palette;
+	float to_float [256];
+} init_job_t;
+
+static void init_entries( void* data, const int index )
+{
+	init_job_t const* job = (init_job_t const*) data;
+	struct ntsc_impl_t const* impl = job->impl;
+	int entry = index * init_block_size;
+	int const last = entry + init_block_size;
 	
-	for ( entry = 0; entry < ntsc_color_count; entry++ )
+	for ( ; entry < last; entry++ )
 	{
-		/* Reduce number of significant bits of source color. Clearing the
-		low bits of R and B were least notictable. Modifying green was too
-		noticeable. */
-		int ir = entry >> 8 & 0x1E;
-		int ig = entry >> 4 & 0x1F;
-		int ib = entry << 1 & 0x1E;
+		int const color = entry & 0x3F;
+		int const emphasis = entry >> 6;
+		unsigned char const* in = &job->palette [color * 3];
+		int ir = in [0];
+		int ig = in [1];
+		int ib = in [2];
 		
+		/* Approximate the emphasis bits the same way as the PPU's color map does
+		for ordinary output, by darkening the other two components. */
+		if ( emphasis && (color & 0x0F) < 0x0E )
 		{
-			float r = to_float [ir];
-			float g = to_float [ig];
-			float b = to_float [ib];
+			if ( emphasis & 6 ) ir = ir * 2 / 3;
+			if ( emphasis & 5 ) ig = ig * 2 / 3;
+			if ( emphasis & 3 ) ib = ib * 2 / 3;
+		}
+		
+		{
+			float r = job->to_float [ir];
+			float g = job->to_float [ig];
+			float b = job->to_float [ib];
 			
 			float y = r * 0.299f + g * 0.587f + b * 0.114f;
 			float i = r * 0.596f - g * 0.275f - b * 0.321f;
 			float q = r * 0.212f - g * 0.523f + b * 0.311f;
 			
 			float iq = i * q;
-			if ( impl.hue_warping && q && iq <= 0 )
+			if ( impl->hue_warping && q && iq <= 0 )
 			{
-				float factor = (iq * impl.hue_warping) / (i * i + q * q);
+				float factor = (iq * impl->hue_warping) / (i * i + q * q);
 				i -= i * factor;
 				q += q * factor;
 			}
 			
-			y = y * impl.contrast + impl.brightness;
+			y = y * impl->contrast + impl->brightness;
 			
 			{
 				float yy = y + rgb_offset;
-				ntsc_rgb_t rgb = TO_RGB( yy, i, q, impl.to_rgb [0] );
-				ntsc_rgb_t* out = ntsc->table [entry];
+				ntsc_rgb_t rgb = TO_RGB( yy, i, q, impl->to_rgb [0] );
+				ntsc_rgb_t* out = job->ntsc->table [entry];
 				
-				gen_kernel( &impl, y, i, q, out );
+				gen_kernel( impl, y, i, q, out );
 				
-				if ( setup->merge_fields )
+				if ( job->setup->merge_fields )
 					merge_fields( out );
 				
 				correct_errors( rgb, out );
@@ -409,6 +422,28 @@ void ntsc_init( ntsc_t* ntsc, ntsc_setup_t const* setup )
 	}
 }
 
+void ntsc_init( ntsc_t* ntsc, ntsc_setup_t const* setup, unsigned char const* palette )
+{
+	init_job_t job;
+	struct ntsc_impl_t impl;
+	if ( !setup )
+		setup = &ntsc_composite;
+	init_ntsc_impl( &impl, setup );
+	
+	{
+		double gamma = 1 - setup->gamma * (setup->gamma > 0 ? 0.5f : 1.5f);
+		int i;
+		for ( i = 0; i < 256; i++ )
+			job.to_float [i] = (float) pow( (1 / 255.0) * i, gamma ) * rgb_unit;
+	}
+	
+	job.ntsc = ntsc;
+	job.impl = &impl;
+	job.setup = setup;
+	job.palette = palette;
+	threads_run( init_entries, &job, ntsc_palette_size / init_block_size );
+}
+
 /* Disable 'restrict' keyword by default. If your compiler supports it, put
 
 	#define restrict restrict
@@ -426,13 +461,13 @@ Enabling this if your compiler supports it will allow better optimization. */
 	#define restrict
 #endif
 
-/* Default to 16-bit RGB input and output */
+/* Default to raw palette input and 32-bit RGB output */
 #ifndef NTSC_IN_FORMAT
-	#define NTSC_IN_FORMAT NTSC_RGB16
+	#define NTSC_IN_FORMAT NTSC_RAW
 #endif
 
 #ifndef NTSC_OUT_DEPTH
-	#define NTSC_OUT_DEPTH 16
+	#define NTSC_OUT_DEPTH 32
 #endif
 
 #include <limits.h>
@@ -452,3 +487,56 @@ Enabling this if your compiler supports it will allow better optimization. */
 		#error "Need 16-bit int type"
 	#endif
 #endif
+
+void ntsc_blit( ntsc_t const* ntsc, unsigned short const* input, long in_row_width,
+		int burst_phase, int in_width, int in_height, void* rgb_out, long out_pitch )
+{
+	int chunk_count = (in_width - 1) / ntsc_in_chunk;
+	for ( ; in_height; --in_height )
+	{
+		unsigned short const* line_in = input;
+		NTSC_LORES_ROW( ntsc, burst_phase,
+				ntsc_black, ntsc_black, line_in [0] );
+		ntsc_out_t* restrict line_out = (ntsc_out_t*) rgb_out;
+		int n;
+		++line_in;
+		
+		for ( n = chunk_count; n; --n )
+		{
+			/* order of input and output pixels must not be altered */
+			NTSC_PIXEL_IN( 0, line_in [0] );
+			NTSC_LORES_OUT( 0, line_out [0], NTSC_OUT_DEPTH );
+			NTSC_LORES_OUT( 1, line_out [1], NTSC_OUT_DEPTH );
+			
+			NTSC_PIXEL_IN( 1, line_in [1] );
+			NTSC_LORES_OUT( 2, line_out [2], NTSC_OUT_DEPTH );
+			NTSC_LORES_OUT( 3, line_out [3], NTSC_OUT_DEPTH );
+			
+			NTSC_PIXEL_IN( 2, line_in [2] );
+			NTSC_LORES_OUT( 4, line_out [4], NTSC_OUT_DEPTH );
+			NTSC_LORES_OUT( 5, line_out [5], NTSC_OUT_DEPTH );
+			NTSC_LORES_OUT( 6, line_out [6], NTSC_OUT_DEPTH );
+			
+			line_in  += 3;
+			line_out += 7;
+		}
+		
+		/* finish final pixels */
+		NTSC_PIXEL_IN( 0, ntsc_black );
+		NTSC_LORES_OUT( 0, line_out [0], NTSC_OUT_DEPTH );
+		NTSC_LORES_OUT( 1, line_out [1], NTSC_OUT_DEPTH );
+		
+		NTSC_PIXEL_IN( 1, ntsc_black );
+		NTSC_LORES_OUT( 2, line_out [2], NTSC_OUT_DEPTH );
+		NTSC_LORES_OUT( 3, line_out [3], NTSC_OUT_DEPTH );
+		
+		NTSC_PIXEL_IN( 2, ntsc_black );
+		NTSC_LORES_OUT( 4, line_out [4], NTSC_OUT_DEPTH );
+		NTSC_LORES_OUT( 5, line_out [5], NTSC_OUT_DEPTH );
+		NTSC_LORES_OUT( 6, line_out [6], NTSC_OUT_DEPTH );
+		
+		burst_phase = (burst_phase + 1) % ntsc_burst_count;
+		input += in_row_width;
+		rgb_out = (char*) rgb_out + out_pitch;
+	}
+}
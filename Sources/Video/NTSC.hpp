@@ -1,5 +1,6 @@
 /* NTSC composite video to RGB emulator/blitter.
-   Based upon the original snes_ntsc v0.2.1, but lightly stripped down somewhat.
+   Based upon the original snes_ntsc v0.2.1, but lightly stripped down somewhat, and adapted to
+   take NES palette indices (plus color emphasis bits) as input in the style of nes_ntsc.
    Originally downloaded from http://www.slack.net/~ant/. */
 
 #ifndef Video__NTSC_hpp__included
@@ -36,20 +37,20 @@ extern ntsc_setup_t const ntsc_rgb;       /* crisp image */
 extern ntsc_setup_t const ntsc_monochrome;/* desaturated + artifacts */
 
 /* Initialize and adjust parameters. Can be called multiple times on the same
-ntsc_t object. Caller must allocate memory for ntsc_t. Can pass 0
-for either parameter. */
+ntsc_t object. Caller must allocate memory for ntsc_t. Can pass 0 for setup.
+Palette holds the 64 NES colors as 8-bit R, G, B triplets; the kernels for
+all eight combinations of color emphasis bits are generated from it. The
+kernels are generated in parallel on the worker threads. */
 typedef struct ntsc_t ntsc_t;
-void ntsc_init( ntsc_t*, ntsc_setup_t const* setup );
-
-/* Blit one or more rows of pixels. Input pixel format is set by NTSC_IN_FORMAT
-and output RGB depth is set by NES_NTSC_OUT_DEPTH. Both default to 16-bit RGB.
-In_row_width is the number of pixels to get to the next input row. Out_pitch
-is the number of *bytes* to get to the next output row. */
-void ntsc_blit( ntsc_t const*, unsigned short const* snes_in,
-		long in_row_width, int burst_phase, int in_width, int in_height,
-		void* rgb_out, long out_pitch );
-
-void ntsc_blit_hires( ntsc_t const*, unsigned short const* snes_in,
+void ntsc_init( ntsc_t*, ntsc_setup_t const* setup, unsigned char const* palette );
+
+/* Blit one or more rows of pixels. Input pixels are palette indices with the
+color emphasis bits in bits 6-8, as output by the PPU in raw mode, and output
+RGB depth is set by NTSC_OUT_DEPTH (32-bit by default). In_row_width is the
+number of pixels to get to the next input row. Out_pitch is the number of
+*bytes* to get to the next output row. Burst_phase is that of the first row;
+it advances by one for every row after that. */
+void ntsc_blit( ntsc_t const*, unsigned short const* nes_in,
 		long in_row_width, int burst_phase, int in_width, int in_height,
 		void* rgb_out, long out_pitch );
 
@@ -68,9 +69,9 @@ value. */
 
 /* Interface for user-defined custom blitters */
 
-enum { ntsc_in_chunk    = 3  }; /* number of snes pixels read per chunk */
+enum { ntsc_in_chunk    = 3  }; /* number of nes pixels read per chunk */
 enum { ntsc_out_chunk   = 7  }; /* number of output pixels generated per chunk */
-enum { ntsc_black       = 0  }; /* palette index for black */
+enum { ntsc_black       = 15 }; /* palette index for black */
 enum { ntsc_burst_count = 3  }; /* burst phase cycles through 0, 1, and 2 */
 
 /* Begin outputting row and start three pixels. First pixel will be cut off a bit.
@@ -108,46 +109,14 @@ statement in a block (unless you're using C++). */
 	NTSC_OUT_( rgb_out, (bits), raw, 1 );\
 }
 
-/* Hires equivalents */
-#define NTSC_HIRES_ROW( ntsc, burst, pixel1, pixel2, pixel3, pixel4, pixel5 ) \
-	char const* ktable = (char*) (ntsc)->table + burst * (ntsc_burst_size * sizeof (ntsc_rgb_t));\
-	int const snes_pixel1_ = (pixel1);\
-	ntsc_rgb_t const* kernel1  = NTSC_IN_FORMAT( snes_pixel1_ );\
-	int const snes_pixel2_ = (pixel2);\
-	ntsc_rgb_t const* kernel2  = NTSC_IN_FORMAT( snes_pixel2_ );\
-	int const snes_pixel3_ = (pixel3);\
-	ntsc_rgb_t const* kernel3  = NTSC_IN_FORMAT( snes_pixel3_ );\
-	int const snes_pixel4_ = (pixel4);\
-	ntsc_rgb_t const* kernel4  = NTSC_IN_FORMAT( snes_pixel4_ );\
-	int const snes_pixel5_ = (pixel5);\
-	ntsc_rgb_t const* kernel5  = NTSC_IN_FORMAT( snes_pixel5_ );\
-	ntsc_rgb_t const* kernel0 = kernel1;\
-	ntsc_rgb_t const* kernelx0;\
-	ntsc_rgb_t const* kernelx1 = kernel1;\
-	ntsc_rgb_t const* kernelx2 = kernel1;\
-	ntsc_rgb_t const* kernelx3 = kernel1;\
-	ntsc_rgb_t const* kernelx4 = kernel1;\
-	ntsc_rgb_t const* kernelx5 = kernel1
-
-#define NTSC_HIRES_OUT( x, rgb_out, bits ) {\
-	ntsc_rgb_t raw =\
-		kernel0  [ x       ] + kernel2  [(x+5)%7+14] + kernel4  [(x+3)%7+28] +\
-		kernelx0 [(x+7)%7+7] + kernelx2 [(x+5)%7+21] + kernelx4 [(x+3)%7+35] +\
-		kernel1  [(x+6)%7  ] + kernel3  [(x+4)%7+14] + kernel5  [(x+2)%7+28] +\
-		kernelx1 [(x+6)%7+7] + kernelx3 [(x+4)%7+21] + kernelx5 [(x+2)%7+35];\
-	NTSC_CLAMP_( raw, 0 );\
-	NTSC_OUT_( rgb_out, (bits), raw, 0 );\
-}
-
-
 /* private */
 
 enum { ntsc_entry_size = 128 };
-enum { ntsc_color_count = 0x2000 };
+enum { ntsc_palette_size = 64 * 8 }; /* 64 colors for each combination of emphasis bits */
 typedef unsigned long ntsc_rgb_t;
 struct ntsc_t
 {
-	ntsc_rgb_t table [ntsc_color_count] [ntsc_entry_size];
+	ntsc_rgb_t table [ntsc_palette_size] [ntsc_entry_size];
 };
 enum { ntsc_burst_size = ntsc_entry_size / ntsc_burst_count };
 
@@ -155,13 +124,10 @@ enum { ntsc_rgb_builder = (1L << 21) | (1 << 11) | (1 << 1) };
 enum { ntsc_clamp_mask = ntsc_rgb_builder * 3 / 2 };
 enum { ntsc_clamp_add  = ntsc_rgb_builder * 0x101 };
 
-#define NTSC_RGB16( n ) \
-	(ntsc_rgb_t*) (ktable + ((n & 0x001E) | (n >> 1 & 0x03E0) | (n >> 2 & 0x3C00)) * \
-			(ntsc_entry_size / 2 * sizeof (ntsc_rgb_t)))
-
-#define NTSC_BGR15( n ) \
-	(ntsc_rgb_t*) (ktable + ((n << 9 & 0x3C00) | (n & 0x03E0) | (n >> 10 & 0x001E)) * \
-			(ntsc_entry_size / 2 * sizeof (ntsc_rgb_t)))
+/* Masked so that a stale frame of ordinary colors can't index outside the table. */
+#define NTSC_RAW( n ) \
+	(ntsc_rgb_t*) (ktable + ((n) & (ntsc_palette_size - 1)) * \
+			(ntsc_entry_size * sizeof (ntsc_rgb_t)))
 
 #define NTSC_CLAMP_( io, shift ) {\
 	ntsc_rgb_t sub = io >> (9-shift) & ntsc_clamp_mask;\
@@ -35,9 +35,13 @@
 
 /* Internal functions:
       These are used exclusively by this file only. */
+// Machine contexts.
+static void RegisterState();
+
 // Color mapping.
 static discrete_function void BuildColorMap();
 static force_inline void MapColor(const UINT8 index, const UINT16 value);
+static UINT16 TintColor(const UINT8 index, const UINT16 value, const bool reds, const bool greens, const bool blues);
 
 // VRAM reading & writing.
 static discrete_function uint8 VRAMRead();
@@ -162,6 +166,10 @@ BOOL   ppu__enable_rendering = TRUE;		// Toggle to disable rendering, used for f
 BOOL   ppu__enable_sprite_back_layer = TRUE;	// Enable drawing of sprites to the framebuffer
 BOOL   ppu__enable_sprite_front_layer = TRUE;	// Same as above, but for front-priority sprites
 BOOL   ppu__force_rendering = FALSE;		// Overrides ppu__enable_rendering
+BOOL   ppu__batch_background = TRUE;		// Draw the background a line at a time when possible
+BOOL   ppu__batch_sprites = TRUE;		// Composite the sprites a line at a time when possible
+BOOL   ppu__minimal_frame_skip = TRUE;		// Only emulate what games can observe for skipped frames
+BOOL   ppu__raw_output = FALSE;			// Output palette indices and emphasis bits instead of colors
 
 // Video memory - name tables and pattern tables.
 PPU__ARRAY( UINT8,        ppu__name_table_dummy,                PPU__NAME_TABLE_DUMMY_SIZE     );
@@ -234,6 +242,10 @@ static bool cache_enable_background_layer = TRUE;
 static bool cache_enable_sprite_back_layer = TRUE;
 static bool cache_enable_sprite_front_layer = TRUE;
 static bool cache_enable_rendering = TRUE;
+static bool cache_batch_background = TRUE;
+static bool cache_batch_sprites = TRUE;
+static bool cache_minimal_frame_skip = TRUE;
+static bool cache_raw_output = FALSE;
 
 /* Since Synchronize() calls other functions such as MMC handlers, and those handlers in turn can
    access the PPU, a re-entry condition develops that could be problematic. In order to solve this,
@@ -252,8 +264,11 @@ static bool cache_enable_rendering = TRUE;
    We want to avoid doing any processing until *all* of the components of the virtual machine have
    been fully initialized, especially the CPU as we depend on its counters. */
 #define SyncHelper() { \
-   if(!(PPUState::initializing || PPUState::synchronizing)) \
+   if(!(PPUState::initializing || PPUState::synchronizing)) { \
+      BENCHMARK_ENTER(BENCHMARK_SECTION_PPU); \
       Synchronize(); \
+      BENCHMARK_LEAVE(); \
+   } \
 }
 
 /* For sprite DMA transfers, this is the number of PPU cycles between each read or write.
@@ -271,6 +286,9 @@ int ppu_init(void)
 {
    using namespace PPUState;
 
+   // Each machine context has its own PPU.
+   RegisterState();
+
    // Begin initialization sequence.
    initializing = 1;
 
@@ -489,6 +507,8 @@ UINT8 ppu_read(const UINT16 address)
 
       // PPUDATA
       case 7:
+         // This increments the VRAM address, which affects the rest of the line being rendered.
+         Renderer::Invalidate();
          return VRAMRead();
    }
 
@@ -504,6 +524,9 @@ void ppu_write(const UINT16 address, const UINT8 data)
       StartOAMDMA(data);
       return;
    }
+
+   // Any of the other registers can affect the rest of the line being rendered.
+   Renderer::Invalidate();
 #if 0
    else if((address < 0x2000) || (address > 0x3FFF))
       // Out of range
@@ -581,9 +604,17 @@ void ppu_write(const UINT16 address, const UINT8 data)
             |+------- Intensify greens (and darken other colors)
             +-------- Intensify blues (and darken other colors) */
 
+         // Enabling or disabling the PPU stops or starts the sprite shift registers mid-line.
+         Renderer::InvalidateSprites();
+
          // Cache it for state saving.
          ppu__register_2001 = data;
 
+         // Which colors get darkened depends on the exact combination of tint bits.
+         const bool tintChanged = (ppu__intensify_reds != DATA_FLAG( INTENSIFY_REDS )) ||
+                                  (ppu__intensify_greens != DATA_FLAG( INTENSIFY_GREENS )) ||
+                                  (ppu__intensify_blues != DATA_FLAG( INTENSIFY_BLUES ));
+
          ppu__palette_mask = DATA_SWITCH( GRAYSCALE );
          ppu__clip_background = !DATA_FLAG( SHOW_BACKGROUND_LEFTMOST_COLUMN );
          ppu__clip_sprites = !DATA_FLAG( SHOW_SPRITES_LEFTMOST_COLUMN );
@@ -601,7 +632,7 @@ void ppu_write(const UINT16 address, const UINT8 data)
          
          /* Color tinting is emulated using a color map. But it is costly to rebuild the
             color map too often, so we only do so when neccessary. */
-         if(tinting != ppu__enable_color_tinting) {
+         if(tintChanged) {
             ppu__enable_color_tinting = tinting;
             BuildColorMap();
          }
@@ -763,6 +794,35 @@ void ppu_sync_update(void)
    SyncHelper();
 }
 
+cpu_time_t ppu_get_frame_time_remaining(void)
+{
+   /* This returns the amount of time (in master clock cycles) until the current frame ends. It
+      does not account for the odd frame clock skip, so it may be one PPU clock too long. */
+   SyncHelper();
+
+   const cpu_time_t ppuCycles = PPUState::scanlineTimer +
+      ((PPU_LAST_LINE - PPUState::scanline) * PPU_SCANLINE_CLOCKS);
+
+   // Buffered cycles already count towards the next PPU clock.
+   const cpu_time_t cycles = ppuCycles * PPU_CLOCK_MULTIPLIER;
+   if(cycles <= PPUState::clockBuffer)
+      return 0;
+
+   return cycles - PPUState::clockBuffer;
+}
+
+cpu_time_t ppu_get_line_time_remaining(void)
+{
+   // This returns the amount of time (in master clock cycles) until the current scanline ends.
+   SyncHelper();
+
+   const cpu_time_t cycles = PPUState::scanlineTimer * PPU_CLOCK_MULTIPLIER;
+   if(cycles <= PPUState::clockBuffer)
+      return 0;
+
+   return cycles - PPUState::clockBuffer;
+}
+
 void ppu_set_option(const ENUM option, const BOOL value)
 {
    switch(option) {
@@ -778,6 +838,18 @@ void ppu_set_option(const ENUM option, const BOOL value)
       case PPU_OPTION_ENABLE_SPRITE_FRONT_LAYER:
          cache_enable_sprite_front_layer = value;
          break;
+      case PPU_OPTION_BATCH_BACKGROUND:
+         cache_batch_background = value;
+         break;
+      case PPU_OPTION_BATCH_SPRITES:
+         cache_batch_sprites = value;
+         break;
+      case PPU_OPTION_MINIMAL_FRAME_SKIP:
+         cache_minimal_frame_skip = value;
+         break;
+      case PPU_OPTION_RAW_OUTPUT:
+         cache_raw_output = value;
+         break;
 
       default:
          WARN_GENERIC();
@@ -823,6 +895,14 @@ BOOL ppu_get_option(const ENUM option)
          return cache_enable_sprite_back_layer;
       case PPU_OPTION_ENABLE_SPRITE_FRONT_LAYER:
          return cache_enable_sprite_front_layer;
+      case PPU_OPTION_BATCH_BACKGROUND:
+         return cache_batch_background;
+      case PPU_OPTION_BATCH_SPRITES:
+         return cache_batch_sprites;
+      case PPU_OPTION_MINIMAL_FRAME_SKIP:
+         return cache_minimal_frame_skip;
+      case PPU_OPTION_RAW_OUTPUT:
+         return cache_raw_output;
 
       default:
          WARN_GENERIC();
@@ -893,6 +973,10 @@ void ppu_load_state(FILE_CONTEXT* file, const int version)
 
    file->read(file, ppu__palette_vram, PPU__PALETTE_VRAM_SIZE);
    file->read(file, ppu__sprite_vram, PPU__SPRITE_VRAM_SIZE);
+
+   // The pattern tables have been replaced wholesale, so discard any decoded tiles.
+   Renderer::FlushCache();
+   Renderer::Invalidate();
 }
 
 void ppu_save_state(FILE_CONTEXT* file, const int version)
@@ -962,6 +1046,7 @@ ENUM ppu_get_mirroring(void)
 void ppu_set_mirroring(const ENUM mirroring)
 {
    SyncHelper();
+   Renderer::Invalidate();
 
    ppu__mirroring = mirroring;
    SetupMirroring();
@@ -978,6 +1063,7 @@ void ppu_set_name_table_address(const int table, UINT8* address)
    RT_ASSERT(address);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    ppu__name_tables_read[table] = address;
    ppu__name_tables_write[table] = address;
@@ -989,6 +1075,7 @@ void ppu_set_name_table_address_read_only(const int table, const UINT8* address)
    RT_ASSERT(address);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    ppu__name_tables_read[table] = address;
    ppu__name_tables_write[table] = ppu__name_table_dummy;
@@ -1010,6 +1097,7 @@ void ppu_set_1k_name_table_vrom_page(const int table, int page)
    RT_ASSERT(page >= 0);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    // CHR-ROM address fixup.
    page = (page & 7) + ROM_CHR_ROM_PAGE_LOOKUP[(page / 8) &
@@ -1024,6 +1112,7 @@ void ppu_set_1k_pattern_table_vram_page(const UINT16 address, int page)
    RT_ASSERT(page >= 0);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    const unsigned index = address / PPU__PATTERN_TABLE_PAGE_SIZE;
    page *= PPU__PATTERN_TABLE_PAGE_SIZE;
@@ -1039,6 +1128,7 @@ void ppu_set_1k_pattern_table_vrom_page(const UINT16 address, int page)
    RT_ASSERT(page >= 0);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    // CHR-ROM address fixup.
    page = (page & 7) + ROM_CHR_ROM_PAGE_LOOKUP
@@ -1057,6 +1147,7 @@ void ppu_set_1k_pattern_table_vrom_page_expanded(const UINT16 address, int page,
    RT_ASSERT(page >= 0);
 
    SyncHelper();
+   Renderer::Invalidate();
 
    if(flags == 0)
       // Nothing to do.
@@ -1104,6 +1195,7 @@ void ppu_set_8k_pattern_table_vram(void)
 void ppu_set_expansion_table_address(const UINT8* address)
 {
    SyncHelper();
+   Renderer::Invalidate();
 
    ppu__expansion_table = address;
 }
@@ -1129,6 +1221,29 @@ void ppu_map_color(const UINT8 index, const UINT16 value) {
    MapColor(index, value);
 }
 
+/* This converts a value from the render buffer back into a 16-bit packed color, e.g for the lightgun.
+   With raw output the buffer holds palette indices and tint bits instead of colors, so these are
+   looked up in the shadowed color map and tinted the same way as MapColor() would. */
+UINT16 ppu_unmap_color(const UINT16 value)
+{
+   if(!ppu__raw_output)
+      return value;
+
+   const UINT8 index = value & (PPU__COLOR_MAP_SIZE - 1);
+   const UINT16 color = PPUState::colorMap[index];
+   if(!ppu__enable_color_tinting)
+      return color;
+
+   return TintColor(index, color, value & 0x40, value & 0x80, value & 0x100);
+}
+
+/* Options set with ppu_set_option() normally take effect at the end of each frame. This applies them
+   immediately, for when the PPU isn't running frames at all (i.e during NSF playback). */
+void ppu_update_options(void)
+{
+   LoadCachedSettings();
+}
+
 UINT16 ppu_get_background_color(void)
 {
    // Note: Don't synchronize from this function or it'll break things.
@@ -1142,6 +1257,90 @@ UINT16 ppu_get_background_color(void)
 // PRIVATE FUNCTIONS
 // --------------------------------------------------------------------------------
 
+/* Makes the state of the PPU part of the current machine context. Cosmetic options
+   (such as the layer toggles) and the color map belong to the host, so are shared. */
+static void RegisterState()
+{
+   using namespace PPUState;
+
+   // Internal state.
+   MACHINE_REGISTER_STATE(addressLatch);
+   MACHINE_REGISTER_STATE(clockBuffer);
+   MACHINE_REGISTER_STATE(clockCounter);
+   MACHINE_REGISTER_STATE(initializing);
+   MACHINE_REGISTER_STATE(isOddFrame);
+   MACHINE_REGISTER_STATE(predictionCycles);
+   MACHINE_REGISTER_STATE(predictionTimestamp);
+   MACHINE_REGISTER_STATE(oamDMAByte);
+   MACHINE_REGISTER_STATE(oamDMAFlipFlop);
+   MACHINE_REGISTER_STATE(oamDMAReadAddress);
+   MACHINE_REGISTER_STATE(oamDMATimer);
+   MACHINE_REGISTER_STATE(oamDMAWriteAddress);
+   MACHINE_REGISTER_STATE(readBuffer);
+   MACHINE_REGISTER_STATE(scanline);
+   MACHINE_REGISTER_STATE(scanlineTimer);
+   MACHINE_REGISTER_STATE(synchronizing);
+   MACHINE_REGISTER_STATE(timeWarp);
+   MACHINE_REGISTER_STATE(vblankQuirkTime);
+   MACHINE_REGISTER_STATE(writeBuffer);
+
+   // Registers, memory and everything else derived from them.
+   MACHINE_REGISTER_STATE(ppu__base_name_table_address);
+   MACHINE_REGISTER_STATE(ppu__generate_interrupts);
+   MACHINE_REGISTER_STATE(ppu__vram_address_increment);
+   MACHINE_REGISTER_STATE(ppu__background_tileset);
+   MACHINE_REGISTER_STATE(ppu__clip_background);
+   MACHINE_REGISTER_STATE(ppu__enable_background);
+   MACHINE_REGISTER_STATE(ppu__clip_sprites);
+   MACHINE_REGISTER_STATE(ppu__enable_sprites);
+   MACHINE_REGISTER_STATE(ppu__sprite_height);
+   MACHINE_REGISTER_STATE(ppu__sprite_tileset);
+   MACHINE_REGISTER_STATE(ppu__intensify_reds);
+   MACHINE_REGISTER_STATE(ppu__intensify_greens);
+   MACHINE_REGISTER_STATE(ppu__intensify_blues);
+   MACHINE_REGISTER_STATE(ppu__palette_mask);
+   MACHINE_REGISTER_STATE(ppu__enabled);
+   MACHINE_REGISTER_STATE(ppu__enable_color_tinting);
+   MACHINE_REGISTER_STATE(ppu__fine_scroll);
+   MACHINE_REGISTER_STATE(ppu__oam_address);
+   MACHINE_REGISTER_STATE(ppu__register_2000);
+   MACHINE_REGISTER_STATE(ppu__register_2001);
+   MACHINE_REGISTER_STATE(ppu__register_2003);
+   MACHINE_REGISTER_STATE(ppu__register_2005);
+   MACHINE_REGISTER_STATE(ppu__register_2006);
+   MACHINE_REGISTER_STATE(ppu__scroll_x_position);
+   MACHINE_REGISTER_STATE(ppu__scroll_y_position);
+   MACHINE_REGISTER_STATE(ppu__vram_address);
+   MACHINE_REGISTER_STATE(ppu__vram_address_latch);
+   MACHINE_REGISTER_STATE(ppu__default_mirroring);
+   MACHINE_REGISTER_STATE(ppu__hblank_started);
+   MACHINE_REGISTER_STATE(ppu__mirroring);
+   MACHINE_REGISTER_STATE(ppu__sprite_collision);
+   MACHINE_REGISTER_STATE(ppu__sprite_overflow);
+   MACHINE_REGISTER_STATE(ppu__vblank_started);
+   MACHINE_REGISTER_STATE(ppu__background_pixels);
+   MACHINE_REGISTER_STATE(ppu__name_table_dummy);
+   MACHINE_REGISTER_STATE(ppu__name_table_vram);
+   MACHINE_REGISTER_STATE(ppu__name_tables_read);
+   MACHINE_REGISTER_STATE(ppu__name_tables_write);
+   MACHINE_REGISTER_STATE(ppu__pattern_table_dummy);
+   MACHINE_REGISTER_STATE(ppu__pattern_table_vram);
+   MACHINE_REGISTER_STATE(ppu__pattern_tables_read);
+   MACHINE_REGISTER_STATE(ppu__pattern_tables_write);
+   MACHINE_REGISTER_STATE(ppu__background_pattern_tables_read);
+   MACHINE_REGISTER_STATE(ppu__background_pattern_tables_write);
+   MACHINE_REGISTER_STATE(ppu__sprite_pattern_tables_read);
+   MACHINE_REGISTER_STATE(ppu__sprite_pattern_tables_write);
+   MACHINE_REGISTER_STATE(ppu__background_palettes);
+   MACHINE_REGISTER_STATE(ppu__palette_vram);
+   MACHINE_REGISTER_STATE(ppu__sprite_palettes);
+   MACHINE_REGISTER_STATE(ppu__sprite_vram);
+   MACHINE_REGISTER_STATE(ppu__expansion_table);
+
+   // Renderer.
+   Renderer::RegisterState();
+}
+
 static discrete_function void BuildColorMap()
 {
    // Restore all colors and recalculate color tinting.
@@ -1153,26 +1352,39 @@ static force_inline void MapColor(const UINT8 index, const UINT16 value)
 {
    RT_ASSERT(index < PPU__COLOR_MAP_SIZE);
 
-   // Start with the original color value.
-   ppu__color_map[index] = value;
+   /* For raw output, the framebuffer receives the palette index with the tint bits in bits 6-8,
+      leaving the conversion to colors (and the tinting) up to the NTSC blitter. */
+   if(ppu__raw_output) {
+      ppu__color_map[index] = index |
+         (ppu__intensify_reds ? 0x40 : 0) | (ppu__intensify_greens ? 0x80 : 0) | (ppu__intensify_blues ? 0x100 : 0);
+      return;
+   }
 
    // If color tinting is not enabled, there's no need to recalculate colors.
-   if(!ppu__enable_color_tinting)
+   if(!ppu__enable_color_tinting) {
+      ppu__color_map[index] = value;
       return;
+   }
 
+   // Store the tinted color value in the color map.
+   ppu__color_map[index] = TintColor(index, value, ppu__intensify_reds, ppu__intensify_greens, ppu__intensify_blues);
+}
+
+static UINT16 TintColor(const UINT8 index, const UINT16 value, const bool reds, const bool greens, const bool blues)
+{
    // Tinting black ($xE and $xF) is a waste of time.
    const UINT8 masked = index & 0x0F;
    if((masked == 0x0E) || (masked == 0x0F))
-      return;
+      return value;
 
    int r, g, b;
    color_unpack_16(value, &r, &g, &b);
 
    /* The color tint bits work on an attenuation cycle. Furthermore, all colors share the same attenuator,
       so activating all three results in a global reduction of intensity. */
-   const bool darkenRed = ppu__intensify_greens || ppu__intensify_blues;
-   const bool darkenGreen = ppu__intensify_reds || ppu__intensify_blues;
-   const bool darkenBlue = ppu__intensify_reds || ppu__intensify_greens;
+   const bool darkenRed = greens || blues;
+   const bool darkenGreen = reds || blues;
+   const bool darkenBlue = reds || greens;
 
    /* It would be fun to emulate the actual NTSC color math here, but as this color map is rebuilt every
       time the color tint bits have changed, and there's the chance of that happening quite a few times
@@ -1184,8 +1396,7 @@ static force_inline void MapColor(const UINT8 index, const UINT16 value)
    if(darkenBlue)
       b = (b * 2) / 3;
 
-   // Store the tinted color value in the color map.
-   ppu__color_map[index] = color_pack_16(r, g, b);
+   return color_pack_16(r, g, b);
 }
 
 /* When reading while the VRAM address is in the range 0-$3EFF,
@@ -1263,6 +1474,9 @@ static discrete_function void VRAMWrite(const uint8 data)
       const int page = address / PPU__PATTERN_TABLE_PAGE_SIZE;
       uint8* write = ppu__pattern_tables_write[page];
       write[address & PPU__PATTERN_TABLE_PAGE_MASK] = data;
+
+      // Any cached copy of this tile is now out of date.
+      Renderer::InvalidateTile(write, address);
    }
    else if(address <= 0x3EFF) {
       // Write to name tables.
@@ -1463,53 +1677,66 @@ static void PredictInterrupts(const cpu_time_t cycles, const unsigned flags)
    if(flags & PPU_PREDICT_MMC_IRQ)
       cpu_clear_interrupt(CPU_INTERRUPT_IRQ_MAPPER_PROXY);
 
-   // Save variables since we just want to simulate.
-   const int16 savedScanline = scanline;
-   const uint16 savedScanlineTimer = scanlineTimer;
-
-   // Note that 'cycles' represents the number of *PPU* cycles to simulate.
-   for(cpu_time_t current = 0; current < cycles; current++) {
-      // Get current scanline clock cycle (starting at 1).
-      const cpu_time_t cycle = (PPU_SCANLINE_CLOCKS - scanlineTimer) + 1;
-
-      bool nmiTrigger = false, irqTrigger = false;
-      if(cycle == 1) {
-         // Scanline start.
-         if((flags & PPU_PREDICT_MMC_IRQ) && mmc_virtual_scanline_start)
-            irqTrigger = mmc_virtual_scanline_start(scanline);
+   const bool predictNMI = (flags & PPU_PREDICT_NMI) && ppu__generate_interrupts;
+   const bool predictIRQ = (flags & PPU_PREDICT_MMC_IRQ) &&
+      (mmc_virtual_scanline_start || mmc_virtual_hblank_start || mmc_virtual_hblank_prefetch_start);
+   if(!predictNMI && !predictIRQ)
+      // Nothing can occur.
+      return;
 
+   /* Rather than simulating every cycle, we only visit the points within each scanline at which
+      an interrupt can occur: the start of the line (VBlank NMI and scanline counters), and the
+      start of HBlank and the HBlank prefetch. 'start' is the offset in *PPU* cycles from now to
+      the start of the line being looked at, which is negative for the current line if it is
+      already in progress. A scanline timer of 0 still takes a cycle to reload. */
+   int16 line = scanline;
+   cpu_rtime_t start = (cpu_rtime_t)((scanlineTimer > 0) ? scanlineTimer : 1) - PPU_SCANLINE_CLOCKS;
+   bool nmiFound = !predictNMI, irqFound = !predictIRQ;
+
+   while(start < (cpu_rtime_t)cycles) {
+      if(!nmiFound && (line == PPU_FIRST_VBLANK_LINE) && (start >= 0)) {
          // VBlank NMI occurs on the 1st cycle of the line after the VBlank flag is set.
-         if((scanline == PPU_FIRST_VBLANK_LINE) &&
-            (flags & PPU_PREDICT_NMI) && ppu__generate_interrupts)
-            nmiTrigger = true;
+         cpu_set_interrupt(CPU_INTERRUPT_NMI, predictionTimestamp + (start * PPU_CLOCK_MULTIPLIER));
+         nmiFound = true;
       }
-      else if((cycle == PPU_HBLANK_START) &&
-              (flags & PPU_PREDICT_MMC_IRQ) && mmc_virtual_hblank_start) {
-         // HBlank start.
-         irqTrigger = mmc_virtual_hblank_start(scanline);
-      }
-      else if((cycle == PPU_HBLANK_PREFETCH_START) &&
-              (flags & PPU_PREDICT_MMC_IRQ) && mmc_virtual_hblank_prefetch_start) {
-         // HBlank prefetch start.
-         irqTrigger = mmc_virtual_hblank_prefetch_start(scanline);
+
+      if(!irqFound) {
+         const cpu_rtime_t hblankStart = start + (PPU_HBLANK_START - 1);
+         const cpu_rtime_t prefetchStart = start + (PPU_HBLANK_PREFETCH_START - 1);
+
+         cpu_rtime_t offset = -1;
+         if((start >= 0) &&
+            mmc_virtual_scanline_start && mmc_virtual_scanline_start(line))
+            offset = start;
+         else if((hblankStart >= 0) && (hblankStart < (cpu_rtime_t)cycles) &&
+                 mmc_virtual_hblank_start && mmc_virtual_hblank_start(line))
+            offset = hblankStart;
+         else if((prefetchStart >= 0) && (prefetchStart < (cpu_rtime_t)cycles) &&
+                 mmc_virtual_hblank_prefetch_start && mmc_virtual_hblank_prefetch_start(line))
+            offset = prefetchStart;
+
+         if(offset >= 0) {
+            cpu_set_interrupt(CPU_INTERRUPT_IRQ_MAPPER_PROXY, predictionTimestamp + (offset * PPU_CLOCK_MULTIPLIER));
+            irqFound = true;
+         }
       }
 
-      if(nmiTrigger || irqTrigger) {
-         // Calculate the time which an interrupt(s) will occur.
-         const cpu_time_t time = predictionTimestamp + (current * PPU_CLOCK_MULTIPLIER);
-         if(nmiTrigger)
-            cpu_set_interrupt(CPU_INTERRUPT_NMI, time);
-         if(irqTrigger)
-            cpu_set_interrupt(CPU_INTERRUPT_IRQ_MAPPER_PROXY, time);
+      // Only the earliest of each interrupt is kept, so there is no point in looking further.
+      if(nmiFound && irqFound)
+         break;
+
+      // Move on to the next scanline, wrapping back around to the beginning of the frame if neccessary.
+      start += PPU_SCANLINE_CLOCKS;
+      if(++line > PPU_LAST_LINE)
+         line = PPU_FIRST_LINE;
+
+      if(irqFound && (line != PPU_FIRST_VBLANK_LINE)) {
+         // Only the NMI is left, so skip straight to the line it occurs on.
+         const int lines = ((PPU_FIRST_VBLANK_LINE - line) + PPU_TOTAL_LINES) % PPU_TOTAL_LINES;
+         start += lines * PPU_SCANLINE_CLOCKS;
+         line = PPU_FIRST_VBLANK_LINE;
       }
-              
-      // Clock the scanline timer.
-      ClockScanlineTimer(scanline);
    }
-
-   // Restore variables.
-   scanline = savedScanline;
-   scanlineTimer = savedScanlineTimer;
 }
 
 static void RepredictInterrupts(const unsigned flags)
@@ -1703,12 +1930,16 @@ static discrete_function void EndFrame()
    PPUState::isOddFrame = !PPUState::isOddFrame;
 
    /* Current frame has ended, but we only have to draw the buffer to the screen
-      if rendering had been enabled (i.e this was not a skipped frame). */
+      if rendering had been enabled (i.e this was not a skipped frame). When there is a
+      presentation thread, this just hands the frame over to it without waiting. */
    if(ppu__enable_rendering) {
       if(gui_is_active)
          gui_update_display();
-      else
+      else {
+         BENCHMARK_ENTER(BENCHMARK_SECTION_VIDEO);
          video_update_display();
+         BENCHMARK_LEAVE();
+      }
    }
 
    // Now we can reload our cached options into the actual variables.
@@ -1747,8 +1978,11 @@ static discrete_function void StartScanline()
    }
 
    // If the MMC has a hook installed, we need to call it.
-   if(mmc_scanline_start)
+   if(mmc_scanline_start) {
+      BENCHMARK_ENTER(BENCHMARK_SECTION_MAPPER);
       mmc_scanline_start(PPUState::scanline);
+      BENCHMARK_LEAVE();
+   }
 }
 
 /* This is only called for scanlines -1 to 239, as the PPU is idle during other lines
@@ -1770,12 +2004,17 @@ static discrete_function void StartScanlineCycle(const cpu_time_t cycle)
       ppu__hblank_started = TRUE;
 
       // If the MMC has a hook installed, we need to call it.
-      if(mmc_hblank_start)
+      if(mmc_hblank_start) {
+         BENCHMARK_ENTER(BENCHMARK_SECTION_MAPPER);
          mmc_hblank_start(PPUState::scanline);
+         BENCHMARK_LEAVE();
+      }
    }
    else if((cycle == PPU_HBLANK_PREFETCH_START) && mmc_hblank_prefetch_start) {
       // Start of the mid-HBlank fetches.
+      BENCHMARK_ENTER(BENCHMARK_SECTION_MAPPER);
       mmc_hblank_prefetch_start(PPUState::scanline);
+      BENCHMARK_LEAVE();
    }
 }
 
@@ -1853,4 +2092,13 @@ static force_inline void LoadCachedSettings()
    ppu__enable_sprite_back_layer = cache_enable_sprite_back_layer;
    ppu__enable_sprite_front_layer = cache_enable_sprite_front_layer;
    ppu__enable_rendering = cache_enable_rendering;
+   ppu__batch_background = cache_batch_background;
+   ppu__batch_sprites = cache_batch_sprites;
+   ppu__minimal_frame_skip = cache_minimal_frame_skip;
+
+   // Switching between colors and raw output changes the meaning of every entry in the color map.
+   if(ppu__raw_output != cache_raw_output) {
+      ppu__raw_output = cache_raw_output;
+      BuildColorMap();
+   }
 }
@@ -30,7 +30,11 @@ enum {
    PPU_OPTION_ENABLE_RENDERING = 0,
    PPU_OPTION_ENABLE_BACKGROUND_LAYER,
    PPU_OPTION_ENABLE_SPRITE_BACK_LAYER,
-   PPU_OPTION_ENABLE_SPRITE_FRONT_LAYER
+   PPU_OPTION_ENABLE_SPRITE_FRONT_LAYER,
+   PPU_OPTION_BATCH_BACKGROUND,
+   PPU_OPTION_BATCH_SPRITES,
+   PPU_OPTION_MINIMAL_FRAME_SKIP,
+   PPU_OPTION_RAW_OUTPUT
 };
 
 enum {
@@ -66,9 +70,12 @@ extern cpu_time_t ppu_execute(const cpu_time_t time);
 extern void ppu_predict_interrupts(const cpu_time_t cycles, const unsigned flags);
 extern void ppu_repredict_interrupts(const unsigned flags);
 extern void ppu_sync_update(void);
+extern cpu_time_t ppu_get_frame_time_remaining(void);
+extern cpu_time_t ppu_get_line_time_remaining(void);
 extern ENUM ppu_get_status(void);
 extern void ppu_set_option(const ENUM option, const BOOL value);
 extern BOOL ppu_get_option(const ENUM option);
+extern void ppu_update_options(void);
 extern void ppu_load_state(FILE_CONTEXT* file, const int version);
 extern void ppu_save_state(FILE_CONTEXT* file, const int version);
 extern ENUM ppu_get_mirroring(void);
@@ -86,6 +93,7 @@ extern void ppu_set_expansion_table_address(const UINT8* address);
 extern void ppu_begin_state_restore(void);
 extern void ppu_end_state_restore(void);
 extern void ppu_map_color(const UINT8 index, const UINT16 value);
+extern UINT16 ppu_unmap_color(const UINT16 value);
 extern UINT16 ppu_get_background_color(void);
 
 #ifdef __cplusplus
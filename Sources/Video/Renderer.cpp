@@ -31,6 +31,7 @@ void Clear()
    render.isOddClock = true;
 
    render.spriteCount = 0;
+   render.spritesBatched = false;
 }
 
 } // namespace anonymous
@@ -59,6 +60,14 @@ void Initialize()
    Sprites::Initialize();
 }
 
+// Each machine context has its own renderer state.
+void RegisterState()
+{
+   MACHINE_REGISTER_STATE(render);
+
+   Background::RegisterState();
+}
+
 /* This gets called at the start of each frame, on PPU_FIRST_LINE, which
    is the dummy (non-visible) sprite evaluation line. */
 void Frame()
@@ -99,6 +108,14 @@ force_inline void Pixel()
    if(rendering && !render.buffer)
       render.buffer = PPU__GET_LINE_ADDRESS(video_get_render_buffer(), render.line);
 
+   /* When frame skipping, the only thing a game could observe from here is a sprite #0 hit, and
+      lines that can produce one are always rendered. The background and sprite state is rebuilt
+      from scratch during HBlank, so there is no need to keep it clocked in the meantime. */
+   if(!rendering && ppu__minimal_frame_skip) {
+      render.pixel++;
+      return;
+   }
+
    // Check if the PPU is completely disabled.
    if(!ppu__enabled) {
       // Skip further processing.
@@ -108,15 +125,33 @@ force_inline void Pixel()
    }
 
    // Check if the background is enabled.
-   if(ppu__enable_background)
-      Background::Pixel(rendering);
+   if(ppu__enable_background) {
+      /* Unless disabled, the background for the whole line is drawn at the first pixel, and
+         from then on the background logic only has to be clocked. */
+      if((render.pixel == 0) && rendering && ppu__batch_background)
+         Background::RenderLine();
+
+      if(render.background.batched)
+         Background::PixelBatched();
+      else
+         Background::Pixel(rendering);
+   }
    else
       // When the background is disabled, we need to produce a backdrop pixel.
       Background::PixelStub(rendering);
 
    // Check if sprite rendering is enabled.
-   if(ppu__enable_sprites)
-      Sprites::Pixel(rendering);
+   if(ppu__enable_sprites) {
+      /* Likewise, the sprites for the whole line are composited into a line buffer at the
+         first pixel, which is then merged with the background one pixel at a time. */
+      if((render.pixel == 0) && rendering && ppu__batch_sprites)
+         Sprites::RenderLine();
+
+      if(render.spritesBatched)
+         Sprites::PixelBatched(rendering);
+      else
+         Sprites::Pixel(rendering);
+   }
 
    // Advance to the next pixel position.
    render.pixel++;
@@ -127,6 +162,12 @@ force_inline void Pixel()
    does not trigger this function. */
 force_inline void Clock()
 {
+   /* Sprite data for the next line is fetched into the shift registers from the first clock
+      after the visible part of the line, so a batched line must be finished before then, or a
+      later Sync() (e.g from a $2001 write during HBlank) would shift the new sprites away. */
+   if((render.clock == (PPU_RENDER_CLOCKS + 1)) && render.spritesBatched)
+      Sprites::Sync();
+
    // Clock the background and sprite generators.
    if(ppu__enable_background)
       Background::Clock();
@@ -138,8 +179,36 @@ force_inline void Clock()
    render.isOddClock = !render.isOddClock;
 }
 
+/* This must be called before anything that affects the background changes (e.g a register
+   write, or a change in memory mapping). If the current line was drawn by RenderLine(), the
+   rest of it will be drawn a pixel at a time instead. */
+force_inline void Invalidate()
+{
+   render.background.batched = false;
+}
+
+/* This must be called before anything that starts or stops the sprite pipeline changes (i.e a
+   write to $2001). If the current line was composited by Sprites::RenderLine(), the sprite shift
+   registers are brought up to date and the rest of it will be drawn a pixel at a time instead. */
+force_inline void InvalidateSprites()
+{
+   if(render.spritesBatched)
+      Sprites::Sync();
+}
+
 #if !defined(INLINE_MA6R)
 
+// These simply pass through to the background tile cache.
+void InvalidateTile(const uint8* page, const unsigned offset)
+{
+   Background::InvalidateTile(page, offset);
+}
+
+void FlushCache()
+{
+   Background::FlushCache();
+}
+
 void Load(PACKFILE* file, const int version)
 {
    RT_ASSERT(file);
@@ -166,6 +235,9 @@ void Load(PACKFILE* file, const int version)
 
    background.counter = pack_getc(file);
 
+   // The rest of the line, if any, is drawn a pixel at a time.
+   background.batched = false;
+
    // Background evaluation
    RenderBackgroundEvaluation& backgroundEvaluation = render.backgroundEvaluation;
 
@@ -218,12 +290,18 @@ void Load(PACKFILE* file, const int version)
       render.secondaryOAM[i] = pack_getc(file);
 
    render.spriteCount = pack_getc(file);
+
+   // As with the background, the rest of the line is drawn a pixel at a time.
+   render.spritesBatched = false;
 }
 
 void Save(PACKFILE* file, const int version)
 {
    RT_ASSERT(file);
 
+   // The sprite shift registers are not clocked while the sprites are batched.
+   InvalidateSprites();
+
    // General
    pack_iputw(render.line, file);
    pack_putc(render.pixel, file);
@@ -57,6 +57,7 @@ typedef struct _RenderBackgroundContext {
    uint8 buffer, bufferTag;	// Attribute for current tile (+shift count)
    uint8 latch, latchTag;	// Attribute for next tile (+shift count)
    uint8 counter;		// Current pixel down-counter (7-0)
+   bool batched;		// Set if the line has been drawn by RenderLine()
 
 } RenderBackgroundContext;
 
@@ -101,6 +102,8 @@ typedef struct _RenderContext {
    RenderSpriteEvaluation spriteEvaluation;
    uint8 secondaryOAM[SecondaryOAMSize];
    uint8 spriteCount;	// Number of sprites in secondary OAM (1-8)
+   uint8 spriteLine[PPU_RENDER_CLOCKS];	// Sprite pixels composited by RenderLine()
+   bool spritesBatched;	// Set if the sprites have been composited by RenderLine()
 
 } RenderContext;
 
@@ -109,10 +112,15 @@ extern RenderContext render;
 // --------------------------------------------------------------------------------
 
 extern void Initialize();
+extern void RegisterState();
 extern void Frame();
 extern void Line(const int line);
 extern void Pixel();
 extern void Clock();
+extern void Invalidate();
+extern void InvalidateSprites();
+extern void InvalidateTile(const uint8* page, const unsigned offset);
+extern void FlushCache();
 extern void Load(FILE_CONTEXT* file, const int version);
 extern void Save(FILE_CONTEXT* file, const int version);
 
@@ -0,0 +1,182 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#include "Local.hpp"
+#include "Scale.hpp"
+
+using namespace std;
+
+namespace {
+
+// Lookup table for converting 16-bit pixels to the target format, rebuilt when the format changes.
+uint32 lookup16[65536];
+int lookupDepth = 0;
+int lookupSignature = -1;
+
+// Scratch space for one source row converted to the target format, and one scaled target row.
+vector<uint32> converted;
+vector<uint8> scaled;
+
+// Maps each visible target column to a source column.
+vector<int> columns;
+
+} // namespace anonymous
+
+// Function prototypes (defined at bottom).
+static void BuildLookup(const int depth);
+static void ConvertRow(BITMAP* source, const int row, const int depth);
+static void ScaleRow(const int depth);
+
+// --------------------------------------------------------------------------------
+
+bool ScaleBlit(BITMAP* source, BITMAP* target, const int x, const int y, const int width, const int height)
+{
+   return ScaleBlitRows(source, target, x, y, width, height, 0, source->h);
+}
+
+bool ScaleBlitRows(BITMAP* source, BITMAP* target, const int x, const int y, const int width, const int height,
+   const int first, const int last)
+{
+   Safeguard(source);
+   Safeguard(target);
+
+   const int sourceDepth = bitmap_color_depth(source);
+   if((sourceDepth != 16) && (sourceDepth != 32))
+      return false;
+
+   const int depth = bitmap_color_depth(target);
+   if((depth != 15) && (depth != 16) && (depth != 24) && (depth != 32))
+      return false;
+
+   if((width <= 0) || (height <= 0))
+      return true;
+
+   /* Target lines are scaled from source line ((line - y) * h) / height, so these are the lines whose
+      source lies within the requested range. */
+   const int firstLine = y + (((first * height) + source->h - 1) / source->h);
+   const int lastLine = y + (((last * height) + source->h - 1) / source->h);
+
+   // Clip the scaled image to the target.
+   const int left = MAX(x, target->cl);
+   const int right = MIN(x + width, target->cr);
+   const int top = MAX(MAX(y, firstLine), target->ct);
+   const int bottom = MIN(MIN(y + height, lastLine), target->cb);
+   if((left >= right) || (top >= bottom))
+      return true;
+
+   if(sourceDepth == 16)
+      BuildLookup(depth);
+
+   const int visible = right - left;
+   columns.resize(visible);
+   for(int i = 0; i < visible; i++)
+      columns[i] = ((left + i - x) * source->w) / width;
+
+   converted.resize(source->w);
+
+   const int bytesPerRow = visible * ((depth + 7) / 8);
+   scaled.resize(bytesPerRow);
+
+   acquire_bitmap(target);
+
+   /* When scaling up, consecutive target rows come from the same source row, so each source row is only
+      converted and scaled once, then copied to as many target rows as it covers. */
+   int lastRow = -1;
+   for(int line = top; line < bottom; line++) {
+      const int row = ((line - y) * source->h) / height;
+      if(row != lastRow) {
+         ConvertRow(source, row, depth);
+         ScaleRow(depth);
+         lastRow = row;
+      }
+
+      const uintptr_t address = bmp_write_line(target, line) + (left * ((depth + 7) / 8));
+      memcpy((void*)address, &scaled[0], bytesPerRow);
+   }
+
+   bmp_unwrite_line(target);
+   release_bitmap(target);
+
+   return true;
+}
+
+// --------------------------------------------------------------------------------
+
+static void BuildLookup(const int depth)
+{
+   // Also check a known color, so that switching between RGB and BGR display modes is noticed.
+   const int signature = makecol_depth(depth, 255, 0, 0) ^ makecol16(255, 0, 0);
+   if((depth == lookupDepth) && (signature == lookupSignature))
+      return;
+
+   for(int i = 0; i < 65536; i++)
+      lookup16[i] = makecol_depth(depth, getr16(i), getg16(i), getb16(i));
+
+   lookupDepth = depth;
+   lookupSignature = signature;
+}
+
+static void ConvertRow(BITMAP* source, const int row, const int depth)
+{
+   const int count = source->w;
+
+   if(bitmap_color_depth(source) == 16) {
+      const uint16* in = (const uint16*)source->line[row];
+      for(int i = 0; i < count; i++)
+         converted[i] = lookup16[in[i]];
+   }
+   else {
+      const uint32* in = (const uint32*)source->line[row];
+      for(int i = 0; i < count; i++) {
+         const int color = in[i];
+         converted[i] = makecol_depth(depth, getr32(color), getg32(color), getb32(color));
+      }
+   }
+}
+
+static void ScaleRow(const int depth)
+{
+   const int count = columns.size();
+
+   switch(depth) {
+      case 15:
+      case 16: {
+         uint16* out = (uint16*)&scaled[0];
+         for(int i = 0; i < count; i++)
+            out[i] = converted[columns[i]];
+
+         break;
+      }
+
+      case 24: {
+         // Packed 24-bit pixels are stored as three bytes, in native byte order.
+         uint8* out = &scaled[0];
+         for(int i = 0; i < count; i++) {
+            const uint32 color = converted[columns[i]];
+#ifdef LSB_FIRST
+            *out++ = color & 0xFF;
+            *out++ = (color >> 8) & 0xFF;
+            *out++ = (color >> 16) & 0xFF;
+#else
+            *out++ = (color >> 16) & 0xFF;
+            *out++ = (color >> 8) & 0xFF;
+            *out++ = color & 0xFF;
+#endif
+         }
+
+         break;
+      }
+
+      case 32: {
+         uint32* out = (uint32*)&scaled[0];
+         for(int i = 0; i < count; i++)
+            out[i] = converted[columns[i]];
+
+         break;
+      }
+   }
+}
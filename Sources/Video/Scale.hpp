@@ -0,0 +1,25 @@
+/* FakeNES - A portable, Open Source NES emulator.
+   Copyright © 2011 Digital Carat
+
+   This is free software. See 'License.txt' for additional copyright and
+   licensing information. You must read and accept the license prior to
+   any modification or use of this software. */
+
+#ifndef Video__Scale_hpp__included
+#define Video__Scale_hpp__included
+#include "Common/Global.h"
+#include "Common/Types.h"
+#include "Local.hpp"
+
+/* Scales a 16 or 32-bit memory bitmap into a 15, 16, 24 or 32-bit target (e.g the screen) at the given
+   position and size, converting between color depths along the way. Unlike a blit() to a temporary
+   buffer followed by stretch_blit(), every source pixel is only read once, and every target pixel
+   only written once. Returns false if either bitmap is in an unsupported format. */
+extern bool ScaleBlit(BITMAP* source, BITMAP* target, const int x, const int y, const int width, const int height);
+
+/* As ScaleBlit(), but only draws the lines of the target that are scaled from source lines 'first' up to
+   (but not including) 'last'. This is used to redraw just the parts of an image that have changed. */
+extern bool ScaleBlitRows(BITMAP* source, BITMAP* target, const int x, const int y, const int width, const int height,
+   const int first, const int last);
+
+#endif // !Video__Scale_hpp__included
@@ -47,6 +47,13 @@ const unsigned Attribute_Priority = _00100000b;
 const unsigned Attribute_HFlip    = _01000000b;
 const unsigned Attribute_VFlip    = _10000000b;
 
+// Layout of each entry in the sprite line buffer. An entry of zero is transparent.
+const unsigned Line_Palette    = Attribute_Palette;
+const unsigned Line_Pixel      = _00001100b;
+const unsigned Line_Priority   = Attribute_Priority;
+const unsigned Line_SpriteZero = _10000000b;
+const int      Line_PixelShift = 2;
+
 force_inline void ClearSprites() {
     for(int i = 0; i < SpritesPerLine; i++) {
        RenderSpriteContext& sprite = render.sprites[i];
@@ -59,6 +66,7 @@ force_inline void ClearSprites() {
     }
 
     render.spriteCount = 0;
+    render.spritesBatched = false;
 }
 
 force_inline void ClearEvaluation() {
@@ -165,6 +173,95 @@ void Initialize() {
 void Line() {
    // Copy evaluation count to spriteCount, as it will be overwritten
    render.spriteCount = render.spriteEvaluation.count;
+
+   render.spritesBatched = false;
+}
+
+/* This composites all of the sprites for the current line into the sprite line buffer at once,
+   rather than shifting every sprite on every pixel. Each entry holds the pixel that Pixel() would
+   produce at that position, before clipping and priority are applied, as those are handled when
+   the line buffer is merged with the background in PixelBatched().
+
+   The sprite shift registers are left as they were at the start of the line. If the line stops
+   being batched part way through, Sync() brings them up to date. */
+void RenderLine()
+{
+   uint8* line = render.spriteLine;
+   memset(line, 0, PPU_RENDER_CLOCKS);
+
+   /* Only the first non-transparent pixel at each position is kept (see FRAMEBUFFER LOCKING in
+      Pixel()), so sprites are composited in priority order and never overwrite each other. */
+   for(int i = 0; i < render.spriteCount; i++) {
+      const RenderSpriteContext& sprite = render.sprites[i];
+      if(sprite.dead)
+         continue;
+
+      unsigned attributes = sprite.latch & (Attribute_Palette | Attribute_Priority);
+      if((i == 0) && (sprite.index == 0))
+         attributes |= Line_SpriteZero;
+
+      // The sprite's first pixel is drawn when its counter reaches zero.
+      for(int x = 0; x < 8; x++) {
+         const int position = sprite.counter + x;
+         if(position >= PPU_RENDER_CLOCKS)
+            break;
+
+         if(line[position] != 0)
+            continue;
+
+         int pixel;
+         if(sprite.latch & Attribute_HFlip)
+            pixel = ((sprite.lowShift >> x) & _00000001b) | (((sprite.highShift >> x) & _00000001b) << 1);
+         else
+            pixel = ((sprite.lowShift >> (7 - x)) & _00000001b) | (((sprite.highShift >> (7 - x)) & _00000001b) << 1);
+
+         if(pixel != 0)
+            line[position] = attributes | (pixel << Line_PixelShift);
+      }
+   }
+
+   render.spritesBatched = true;
+}
+
+/* This stops batching for the rest of the line, clocking the sprite shift registers once for each
+   pixel that has been drawn so far, exactly as Pixel() would have. It must not be called once the
+   sprites for the next line have started being fetched, which Renderer::Clock() ensures. */
+void Sync()
+{
+   // The pixel position wraps back to zero once the last pixel of the line has been drawn.
+   const int clocks = (render.clock > PPU_RENDER_CLOCKS) ? PPU_RENDER_CLOCKS : render.pixel;
+
+   for(int i = 0; i < render.spriteCount; i++) {
+      RenderSpriteContext& sprite = render.sprites[i];
+      if(sprite.dead)
+         continue;
+
+      if(sprite.counter >= clocks) {
+         sprite.counter -= clocks;
+         continue;
+      }
+
+      const int shift = clocks - sprite.counter;
+      sprite.counter = 0;
+
+      if(shift >= 8) {
+         sprite.lowShift = 0x00;
+         sprite.highShift = 0x00;
+      }
+      else if(sprite.latch & Attribute_HFlip) {
+         sprite.lowShift >>= shift;
+         sprite.highShift >>= shift;
+      }
+      else {
+         sprite.lowShift <<= shift;
+         sprite.highShift <<= shift;
+      }
+
+      if((sprite.lowShift + sprite.highShift) == 0x00)
+         sprite.dead = TRUE;
+   }
+
+   render.spritesBatched = false;
 }
 
 #endif
@@ -297,6 +394,43 @@ force_inline void Pixel(const bool rendering)
     }
 }
 
+/* This is used in place of Pixel() when the sprites for the line have been composited by RenderLine().
+   The rules are the same as above, but only a single, already-resolved sprite pixel is involved. */
+force_inline void PixelBatched(const bool rendering)
+{
+    if(!rendering)
+       return;
+
+    const unsigned entry = render.spriteLine[render.pixel];
+    if(entry == 0)
+       return;
+
+    // Check if we should clip sprites on the left side of the screen
+    if((render.pixel <= 7) && ppu__clip_sprites)
+       return;
+
+    // Sprite #0 hit test.
+    if((entry & Line_SpriteZero) && !ppu__sprite_collision) {
+       if(R_GetBackgroundPixel() != 0)
+          ppu__sprite_collision = TRUE;
+    }
+
+    if(entry & Line_Priority) {
+       if(R_GetBackgroundPixel() != 0)
+          return;
+
+       if(!ppu__enable_sprite_back_layer)
+          return;
+    }
+    else
+       if(!ppu__enable_sprite_front_layer)
+          return;
+
+    const int palette = entry & Line_Palette;
+    const int pixel = (entry & Line_Pixel) >> Line_PixelShift;
+    R_PutFramePixel( PPU__SPRITE_PALETTE(palette, pixel) );
+}
+
 #define MAIN_LOOP	main_loop
 #define STATE1_LOOP	state1_loop
 #define STATE3_LOOP	state3_loop
@@ -17,7 +17,10 @@ extern R_LookupTable( SequenceTable );
 
 extern void Initialize();
 extern void Line();
+extern void RenderLine();
+extern void Sync();
 extern void Pixel(const bool rendering);
+extern void PixelBatched(const bool rendering);
 extern void Clock();
 
 } // namespace Sprites
@@ -6,13 +6,16 @@
    any modification or use of this software. */
 
 #include "Color.h"
+#include "HQX.hpp"
 #include "Internals.h"
 #include "Local.hpp"
+#include "NTSC.hpp"
 #include "PPU.h"
+#include "Scale.hpp"
 #include "Video.h"
+#include "Platform/Threads.h"
 
 // TODO: Finish display update routines.
-// TODO: Check for non-power-of-2 texture support.
 // TODO: Move OpenGL stuff into its own container and initialize it properly.
 // TODO: Color correction quantization and tinting.
 // TODO: Verify that all settings are in a valid range.
@@ -32,9 +35,17 @@ static void ExitOpenGL();
 static bool IsOpenGL();
 static void LoadFonts();
 static void UpdateColor();
-static void UpdateDisplay();
+static void UpdateNTSC(const RGB* palette);
+static void UpdateDisplay(BITMAP* frame);
+static BITMAP* BlitHQX(BITMAP* source, const int scale);
+static void BlitHQXBand(void* data, const int index);
+static BITMAP* BlitNTSC(BITMAP* source);
+static void BlitNTSCBand(void* data, const int index);
 static void UpdateScreen();
 static void UpdateScreenOpenGL();
+#ifdef USE_ALLEGROGL
+static bool UploadOpenGLFrame(BITMAP* frame);
+#endif
 static void DrawLightgunCursor();
 static void DrawHUD();
 static void DrawMessages();
@@ -45,11 +56,21 @@ static const int PagesForPageFlipping = 2;
 static const int PagesForTripleBuffering = 3;
 static const int MaximumPages = 3;
 
+/* Completed frames are handed to the presentation thread through a triple buffer: the emulation
+   fills one frame, the presentation thread shows another, and the third holds the latest complete
+   frame. Swapping a frame in or out of the middle slot is a single atomic exchange. */
+static const int PresentFrames = 3;
+static const int PresentFresh = 1 << 2;		// Set on the middle slot when it holds a frame not yet shown.
+static const int PresentTimeout = 2;		// How often (ms) the thread looks for frames without a wakeup.
+
 // Buffers used for drawing both to memory and the screen.
 typedef struct _VideoBuffers {
    BITMAP* display;		// Buffer for the display. Slow, avoid when possible.
    BITMAP* blit, *filter;	// Hold output from filters and blitters, sized as needed, 16-bit.
    BITMAP* extra;		// Extra buffer used for compatibility situations.
+   BITMAP* frames[PresentFrames];	// Completed frames for the presentation thread, always 256x240, 16-bit.
+   BITMAP* hqx;			// Holds output from the HQX blitters, sized as needed, 32-bit.
+   BITMAP* ntsc;		// Holds output from the NTSC blitter, sized as needed, 32-bit.
    BITMAP* overlay;		// This usually just points to render.
    BITMAP* pages[MaximumPages];	// Virtual screens for hardware acceleration.
    int pageCount, currentPage;
@@ -77,6 +98,7 @@ typedef struct _VideoDisplay {
    RGB_MAP rgbMap;	// For fast truecolor to indexed color conversions.
    bool swapRGB;	// Set when red and blue need to be swapped.
    bool doubleBuffer;	// Use display double-buffering, e.g for the GUI.
+   bool headless;	// There is no display at all, see video_init_headless().
 
 } VideoDisplay;
 
@@ -114,6 +136,15 @@ typedef struct VideoOutput {
 
 } VideoOutput;
 
+/* Tracks which lines of a buffer have changed since it was last shown, so that static images (e.g menus,
+   or a paused game) don't have to be pushed to the screen again. */
+typedef struct _VideoDirtyLines {
+   BITMAP* shadow;		// Copy of the buffer as it was last shown.
+   vector<bool> lines;		// Set for each line that differs from the copy.
+   bool refresh;		// Treat every line as changed next time, e.g after the screen was overwritten.
+
+} VideoDirtyLines;
+
 #ifdef ALLEGRO_UNIX
 /* The X header files define Display as something else, so we have to use this hack to get around it.
    I *really* get tired of OS APIs polluting the primary namespace. */
@@ -127,6 +158,24 @@ static VideoFonts Fonts;
 static VideoOptions Options;
 static VideoOutput Output;
 
+// Dirty line tracking for the render buffer (game display) and the display buffer (GUI).
+static VideoDirtyLines renderLines;
+static VideoDirtyLines displayLines;
+
+static int FindDirtyLines(BITMAP* bitmap, VideoDirtyLines& tracker);
+static bool NextDirtySpan(const VideoDirtyLines& tracker, int& first, int& last);
+
+/* Presentation thread. The lock is held while a frame is being shown, and by the emulation thread
+   whenever it has to touch the screen or anything that showing a frame depends on. */
+static THREAD* presentThread = NULL;
+static THREAD_LOCK* presentLock = NULL;
+static volatile int presentMiddle = 0;
+static int presentBack = 1, presentFront = 2;
+
+static void StartPresentation();
+static void StopPresentation();
+static void Present(THREAD* thread, void* data);
+
 /* This is a list of things that have been changed, used for video_update_settings().
    This isn't the most appealing way to do this, but it works. */
 enum {
@@ -147,6 +196,65 @@ static GLuint displayTexture = 0;
 /* Our OpenGL display list, just to reduce the amount of code needed to draw
    the textured quad in a number of different configurations. */
 static GLuint displayList = 0;
+
+/* Frames are streamed to the display texture through a ring of pixel buffer objects, when they are
+   supported. Each frame is written into the next buffer in the ring, so the CPU never has to wait
+   on a buffer that the GL is still copying the previous frame out of. */
+static const int OpenGLStreamBuffers = 3;
+
+static bool streamAvailable = false;
+static GLuint streamBuffers[OpenGLStreamBuffers];
+static int streamIndex = 0;
+
+// Size of the display texture, which may be larger than the frame if power-of-2 sizes are required.
+static bool textureAnySize = false;
+static int textureWidth = 0, textureHeight = 0;
+
+// The last frame that was uploaded, and the geometry that was compiled into the display list.
+static BITMAP* openGLFrame = NULL;
+static int frameWidth = 0, frameHeight = 0;
+static int quadX = 0, quadY = 0, quadWidth = 0, quadHeight = 0;
+
+// These are not in OpenGL 1.1, which is all that some platforms' headers provide.
+#ifndef GL_BGR
+#define GL_BGR				0x80E0
+#endif
+#ifndef GL_BGRA
+#define GL_BGRA				0x80E1
+#endif
+#ifndef GL_UNSIGNED_SHORT_5_6_5
+#define GL_UNSIGNED_SHORT_5_6_5		0x8363
+#endif
+#ifndef GL_UNSIGNED_SHORT_5_6_5_REV
+#define GL_UNSIGNED_SHORT_5_6_5_REV	0x8364
+#endif
+#ifndef GL_UNSIGNED_SHORT_1_5_5_5_REV
+#define GL_UNSIGNED_SHORT_1_5_5_5_REV	0x8366
+#endif
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+#define GL_PIXEL_UNPACK_BUFFER_ARB	0x88EC
+#endif
+#ifndef GL_STREAM_DRAW_ARB
+#define GL_STREAM_DRAW_ARB		0x88E0
+#endif
+#ifndef GL_WRITE_ONLY_ARB
+#define GL_WRITE_ONLY_ARB		0x88B9
+#endif
+
+// Buffer object entry points, which have to be looked up at runtime.
+typedef void (APIENTRY* GLGenBuffersFunction)(GLsizei, GLuint*);
+typedef void (APIENTRY* GLDeleteBuffersFunction)(GLsizei, const GLuint*);
+typedef void (APIENTRY* GLBindBufferFunction)(GLenum, GLuint);
+typedef void (APIENTRY* GLBufferDataFunction)(GLenum, ptrdiff_t, const GLvoid*, GLenum);
+typedef GLvoid* (APIENTRY* GLMapBufferFunction)(GLenum, GLenum);
+typedef GLboolean (APIENTRY* GLUnmapBufferFunction)(GLenum);
+
+static GLGenBuffersFunction glGenBuffersPointer = NULL;
+static GLDeleteBuffersFunction glDeleteBuffersPointer = NULL;
+static GLBindBufferFunction glBindBufferPointer = NULL;
+static GLBufferDataFunction glBufferDataPointer = NULL;
+static GLMapBufferFunction glMapBufferPointer = NULL;
+static GLUnmapBufferFunction glUnmapBufferPointer = NULL;
 #endif
 
 // Support for showing chat and log messages.
@@ -161,6 +269,32 @@ typedef struct _Message {
 typedef vector<Message> History;
 static History history;
 
+/* Generating the NTSC blitter's kernels is expensive, so the most recently used sets are kept around
+   for when the color controls are stepped back and forth. */
+static const int NTSCCacheSize = 4;
+
+// Everything that the NTSC kernels are generated from.
+typedef struct _VideoNTSCKey {
+   ENUM palette;
+   real hue, saturation;
+   real brightness, contrast;
+   real gamma;
+   bool swapRGB;
+
+} VideoNTSCKey;
+
+typedef struct _VideoNTSCCache {
+   VideoNTSCKey key;
+   ntsc_t* kernels;	// NULL when the slot is unused.
+   unsigned lastUsed;	// For picking which slot to replace.
+
+} VideoNTSCCache;
+
+static VideoNTSCCache ntscCache[NTSCCacheSize];
+static unsigned ntscCacheClock = 0;
+static ntsc_t* ntscKernels = NULL;	// Kernels for the current color settings.
+static int ntscBurstPhase = 0;
+
 // These functions handle when the user switches to or from the program.
 static void SwitchAway(void)
 {
@@ -172,6 +306,10 @@ static void SwitchBack(void)
 {
    if(file_is_loaded)
       apu_options.squelch = !apu_options.squelch;
+
+   // The contents of the screen are lost when switching away in fullscreen modes.
+   renderLines.refresh = true;
+   displayLines.refresh = true;
 }
 
 // This macro helps with clearing the memory used by bitmaps.
@@ -309,11 +447,47 @@ int video_init(void)
       WARN("The program is now running in safe mode. Check the log for details.");
    }
 
+   StartPresentation();
+
+   return 0;
+}
+
+/* Sets up only what the PPU needs in order to render, which is the render buffer and the
+   color map, without touching the display. Frames are rendered as normal, but never shown.
+   This is for running without a display (e.g batch runs), and is undone by video_exit(). */
+int video_init_headless(void)
+{
+   Buffers.render = create_bitmap_ex(16, 256, 240);
+   if(!Buffers.render) {
+      log_printf("Couldn't create the rendering buffer for headless operation.\n");
+      return 1;
+   }
+
+   clear_bitmap(Buffers.render);
+   Buffers.overlay = Buffers.render;
+
+   // Pixels are always stored as RGB, as there is no display to match.
+   Display.swapRGB = false;
+   video__swap_rgb = FALSE;
+
+   UpdateColor();
+
+   Display.headless = true;
+
    return 0;
 }
 
 void video_exit(void)
 {
+   if(Display.headless) {
+      FreeBitmap(Buffers.render);
+      Buffers.overlay = NULL;
+
+      Display.headless = false;
+      return;
+   }
+
+   StopPresentation();
    Exit();
 }
 
@@ -420,8 +594,15 @@ BOOL video_get_profile_boolean(const ENUM key)
    return FALSE;
 }
 
+/* The presentation thread reads these settings while it shows a frame, so they are only changed while
+   holding the presentation lock. */
 void video_set_profile_integer(const ENUM key, const int value)
 {
+   threads_lock(presentLock);
+
+   // Any change to the settings might affect how the game display looks, so it must be shown again in full.
+   renderLines.refresh = true;
+
    switch(key) {
       case VIDEO_PROFILE_DISPLAY_DRIVER:
       case VIDEO_PROFILE_DISPLAY_WIDTH:
@@ -448,10 +629,17 @@ void video_set_profile_integer(const ENUM key, const int value)
          WARN_GENERIC();
          break;
    }
+
+   threads_unlock(presentLock);
 }
 
 void video_set_profile_real(const ENUM key, const REAL value)
 {
+   threads_lock(presentLock);
+
+   // Any change to the settings might affect how the game display looks, so it must be shown again in full.
+   renderLines.refresh = true;
+
    switch(key) {
       case VIDEO_PROFILE_COLOR_HUE:
       case VIDEO_PROFILE_COLOR_SATURATION:
@@ -489,10 +677,17 @@ void video_set_profile_real(const ENUM key, const REAL value)
          WARN_GENERIC();
          break;
    }
+
+   threads_unlock(presentLock);
 }
 
 void video_set_profile_enum(const ENUM key, const ENUM value)
 {
+   threads_lock(presentLock);
+
+   // Any change to the settings might affect how the game display looks, so it must be shown again in full.
+   renderLines.refresh = true;
+
    switch(key) {
       case VIDEO_PROFILE_COLOR_PALETTE: {
          Color.palette = value;
@@ -500,18 +695,28 @@ void video_set_profile_enum(const ENUM key, const ENUM value)
          break;
       }
 
-      case VIDEO_PROFILE_OUTPUT_BLITTER:
+      case VIDEO_PROFILE_OUTPUT_BLITTER: {
          Output.blitter = value;
+         // Switching to or from the NTSC blitter changes how colors are mapped.
+         LIST_ADD(dirty, DirtyColor);
          break;
+      }
 
       default:
          WARN_GENERIC();
          break;
    }
+
+   threads_unlock(presentLock);
 }
 
 void video_set_profile_boolean(const ENUM key, const BOOL value)
 {
+   threads_lock(presentLock);
+
+   // Any change to the settings might affect how the game display looks, so it must be shown again in full.
+   renderLines.refresh = true;
+
    switch(key) {
       case VIDEO_PROFILE_OPTION_ACCELERATION:
       case VIDEO_PROFILE_OPTION_DITHER:
@@ -522,6 +727,7 @@ void video_set_profile_boolean(const ENUM key, const BOOL value)
    switch(key) {
       case VIDEO_PROFILE_DISPLAY_DOUBLE_BUFFER:
          Display.doubleBuffer = value;
+         displayLines.refresh = true;
          break;
 
       case VIDEO_PROFILE_FILTER_ASPECT_RATIO:
@@ -564,22 +770,61 @@ void video_set_profile_boolean(const ENUM key, const BOOL value)
          WARN_GENERIC();
          break;
    }
+
+   threads_unlock(presentLock);
 }
 
 void video_update_display(void)
 {
+   // Without a display, there is nothing to update.
+   if(Display.headless)
+      return;
+
    /* When the GUI is active, we follow a simplified pipeline, as it has already
       taken care of most of what we need to do. */
    if(gui_is_active) {
+      threads_lock(presentLock);
       UpdateScreen();
+
+      // The GUI may have drawn over the game display, so it has to be shown in full once the GUI is closed.
+      renderLines.refresh = true;
+      threads_unlock(presentLock);
       return;
    }
 
    // Update the game display. This includes things like the HUD.
    video_update_game_display();
 
+   /* Hand the frame over to the presentation thread, so that emulation can carry on while it is being
+      shown. If the last frame still hasn't been picked up, it is simply replaced by this one. */
+   if(presentThread) {
+      BITMAP* frame = Buffers.frames[presentBack];
+      blit(Buffers.render, frame, 0, 0, 0, 0, frame->w, frame->h);
+
+      presentBack = threads_exchange(&presentMiddle, presentBack | PresentFresh) & ~PresentFresh;
+      threads_wake(presentThread);
+      return;
+   }
+
    // Finally we can display it all.
-   UpdateDisplay();
+   UpdateDisplay(Buffers.render);
+}
+
+/* Returns TRUE if frames are being shown by the presentation thread, rather than as part of
+   video_update_display(). */
+BOOL video_is_threaded(void)
+{
+   return presentThread ? TRUE : FALSE;
+}
+
+/* Returns TRUE if the presentation thread still hasn't picked up the last frame. Another frame
+   drawn now would only replace it, so this can be used to decide when to skip frames. */
+BOOL video_is_busy(void)
+{
+   if(!presentThread)
+      return FALSE;
+
+   return (presentMiddle & PresentFresh) ? TRUE : FALSE;
 }
 
 void video_update_game_display(void)
@@ -607,7 +852,9 @@ void video_update_settings(void)
    else if(LIST_COMPARE(dirty, DirtyColor)) {
       /* We only need to handle this if the display wasn't dirty, as reinitializing the display
         automatically sets up the color system again with the latest settings. */
+      threads_lock(presentLock);
       UpdateColor();
+      threads_unlock(presentLock);
    }
 
    dirty = DirtyNone;
@@ -620,21 +867,27 @@ void video_handle_keypress(const int c, const int scancode)
 
    switch(scancode) {
       case KEY_F10: {
+         threads_lock(presentLock);
+
          Color.gamma -= 5;
          if(Color.gamma < -100)
             Color.gamma = -100;
 
          UpdateColor();
+         threads_unlock(presentLock);
 
          break;
       }
 
       case KEY_F11: {
+         threads_lock(presentLock);
+
          Color.gamma += 5;
          if(Color.gamma > 100)
             Color.gamma = 100;
 
          UpdateColor();
+         threads_unlock(presentLock);
 
          break;
       }
@@ -722,6 +975,29 @@ BITMAP* video_get_render_buffer(void)
    return Buffers.render;
 }
 
+/* Returns a copy of the render buffer with colors in it, for use outside of the normal display (e.g
+   for snapshots, or behind the GUI). With raw output the render buffer holds palette indices, which
+   are converted back to colors here. The copy must be freed with destroy_bitmap(). */
+BITMAP* video_copy_render_buffer(void)
+{
+   if(!Buffers.render)
+      return NULL;
+
+   BITMAP* copy = create_bitmap_ex(16, Buffers.render->w, Buffers.render->h);
+   if(!copy)
+      return NULL;
+
+   for(int y = 0; y < copy->h; y++) {
+      const uint16* source = (const uint16*)Buffers.render->line[y];
+      uint16* destination = (uint16*)copy->line[y];
+
+      for(int x = 0; x < copy->w; x++)
+         destination[x] = ppu_unmap_color(source[x]);
+   }
+
+   return copy;
+}
+
 FONT* video_get_font(const ENUM type) {
    bool lowRes = false;
    if((SCREEN_W < 512) || (SCREEN_H < 448))
@@ -975,6 +1251,12 @@ static bool Initialize()
    Buffers.blit = NULL;
    Buffers.extra = NULL;
    Buffers.filter = NULL;
+
+   for(int i = 0; i < PresentFrames; i++)
+      Buffers.frames[i] = NULL;
+
+   Buffers.hqx = NULL;
+   Buffers.ntsc = NULL;
    Buffers.overlay = NULL;
    Buffers.render = NULL;
 
@@ -984,9 +1266,13 @@ static bool Initialize()
    Buffers.pageCount = 0;
    Buffers.currentPage = 0;
 
+   renderLines.shadow = NULL;
+   displayLines.shadow = NULL;
+
    Display.indexed = false;
    Display.swapRGB = false;
    Display.doubleBuffer = false;
+   Display.headless = false;
 
    Fonts.smallLow = NULL;
    Fonts.mediumLow = NULL;
@@ -1006,6 +1292,9 @@ static bool Initialize()
    memset(&Display.palette, 0, sizeof(PALETTE));
    memset(&Display.rgbMap, 0, sizeof(RGB_MAP));
 
+   // Build the lookup tables used by the HQX blitters.
+   HQX_Initialize();
+
    // Display miscellaneous information.
    const string nothing = "";
 
@@ -1391,6 +1680,8 @@ static void Exit()
    FreeBitmap(Buffers.blit);
    FreeBitmap(Buffers.extra);
    FreeBitmap(Buffers.filter);
+   FreeBitmap(Buffers.hqx);
+   FreeBitmap(Buffers.ntsc);
    // FreeBitmap(Buffers.overlay);
    FreeBitmap(Buffers.render);
 
@@ -1399,6 +1690,19 @@ static void Exit()
 
    Buffers.pageCount = 0;
 
+   FreeBitmap(renderLines.shadow);
+   FreeBitmap(displayLines.shadow);
+
+   // Destroy any cached NTSC kernels.
+   for(int i = 0; i < NTSCCacheSize; i++) {
+      if(ntscCache[i].kernels) {
+         free(ntscCache[i].kernels);
+         ntscCache[i].kernels = NULL;
+      }
+   }
+
+   ntscKernels = NULL;
+
    // Remove callbacks.
    remove_display_switch_callback(SwitchAway);
    remove_display_switch_callback(SwitchBack);
@@ -1499,7 +1803,42 @@ static bool SetupOpenGL()
 
    // This probably isn't needed, but it doesn't hurt.
    glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
- 
+
+   // Without non-power-of-2 textures, frames are placed in the corner of a larger texture.
+   textureAnySize = (allegro_gl_opengl_version() >= 2.0) ||
+                    allegro_gl_is_extension_supported("GL_ARB_texture_non_power_of_two");
+   textureWidth = 0;
+   textureHeight = 0;
+
+   if(textureAnySize)
+      log_printf("Found support for non-power-of-2 textures.\n");
+
+   // Set up streaming through pixel buffer objects, if they are supported.
+   streamAvailable = false;
+   streamIndex = 0;
+
+   if((allegro_gl_opengl_version() >= 2.1) ||
+      allegro_gl_is_extension_supported("GL_ARB_pixel_buffer_object")) {
+      glGenBuffersPointer = (GLGenBuffersFunction)allegro_gl_get_proc_address("glGenBuffersARB");
+      glDeleteBuffersPointer = (GLDeleteBuffersFunction)allegro_gl_get_proc_address("glDeleteBuffersARB");
+      glBindBufferPointer = (GLBindBufferFunction)allegro_gl_get_proc_address("glBindBufferARB");
+      glBufferDataPointer = (GLBufferDataFunction)allegro_gl_get_proc_address("glBufferDataARB");
+      glMapBufferPointer = (GLMapBufferFunction)allegro_gl_get_proc_address("glMapBufferARB");
+      glUnmapBufferPointer = (GLUnmapBufferFunction)allegro_gl_get_proc_address("glUnmapBufferARB");
+
+      if(glGenBuffersPointer && glDeleteBuffersPointer && glBindBufferPointer &&
+         glBufferDataPointer && glMapBufferPointer && glUnmapBufferPointer) {
+         glGenBuffersPointer(OpenGLStreamBuffers, streamBuffers);
+         streamAvailable = true;
+
+         log_printf("Found GL_ARB_pixel_buffer_object.\n"
+                    "Streaming frames through %d pixel buffers.\n", OpenGLStreamBuffers);
+      }
+   }
+
+   if(!streamAvailable)
+      log_printf("No pixel buffer objects available. Uploading frames directly.\n");
+
    return true;
 #endif
 }
@@ -1516,6 +1855,17 @@ static void ExitOpenGL()
       glDeleteLists(displayList, 1);
       displayList = 0;
    }
+
+   if(streamAvailable) {
+      glDeleteBuffersPointer(OpenGLStreamBuffers, streamBuffers);
+      streamAvailable = false;
+   }
+
+   openGLFrame = NULL;
+   frameWidth = 0;
+   frameHeight = 0;
+   quadWidth = 0;
+   quadHeight = 0;
 #endif
 }
 
@@ -1557,6 +1907,9 @@ static void LoadFonts()
 
 static void UpdateColor()
 {
+   // Colors are changing, so the game display will need to be shown again in full.
+   renderLines.refresh = true;
+
    // Determine which palette to use.
    RGB* palette = NULL;
    switch(Color.palette) {
@@ -1581,6 +1934,22 @@ static void UpdateColor()
          break;
    }
 
+   /* The NTSC blitter takes raw palette indices from the PPU and applies the color controls as part
+      of generating its kernels, so none of the work below is needed for it. The PPU still needs
+      colors to turn raw output back into (e.g for the lightgun), for which the palette will do. */
+   const bool ntsc = Output.blitter == VIDEO_BLITTER_NTSC;
+   ppu_set_option(PPU_OPTION_RAW_OUTPUT, ntsc);
+   if(ntsc) {
+      UpdateNTSC(palette);
+
+      for(int i = 0; i < PPU__COLOR_MAP_SIZE; i++) {
+         const RGB& color = palette[i + 1];
+         ppu_map_color(i, color_pack_16(color.r << 2, color.g << 2, color.b << 2));
+      }
+
+      return;
+   }
+
    for(int i = 0; i < PPU__COLOR_MAP_SIZE; i++) {
       // Get our color from the palette. For legacy reasons, they are offset by one.
       const RGB& color = palette[i + 1];
@@ -1669,53 +2038,515 @@ static void UpdateColor()
    }
 }
 
-static void UpdateDisplay()
+// Selects the NTSC kernels for the current color settings, generating them if they aren't cached.
+static void UpdateNTSC(const RGB* palette)
+{
+   VideoNTSCKey key;
+   key.palette = Color.palette;
+   key.hue = Color.hue;
+   key.saturation = Color.saturation;
+   key.brightness = Color.brightness;
+   key.contrast = Color.contrast;
+   key.gamma = Color.gamma;
+   key.swapRGB = video__swap_rgb;
+
+   VideoNTSCCache* slot = NULL;
+   for(int i = 0; i < NTSCCacheSize; i++) {
+      VideoNTSCCache& entry = ntscCache[i];
+      if(entry.kernels &&
+         (entry.key.palette == key.palette) &&
+         (entry.key.hue == key.hue) && (entry.key.saturation == key.saturation) &&
+         (entry.key.brightness == key.brightness) && (entry.key.contrast == key.contrast) &&
+         (entry.key.gamma == key.gamma) &&
+         (entry.key.swapRGB == key.swapRGB)) {
+         slot = &entry;
+         break;
+      }
+   }
+
+   if(!slot) {
+      // Take an unused slot if there is one, otherwise replace the least recently used set.
+      slot = &ntscCache[0];
+      for(int i = 0; i < NTSCCacheSize; i++) {
+         VideoNTSCCache& entry = ntscCache[i];
+         if(!entry.kernels) {
+            slot = &entry;
+            break;
+         }
+
+         if(entry.lastUsed < slot->lastUsed)
+            slot = &entry;
+      }
+
+      if(!slot->kernels) {
+         slot->kernels = (ntsc_t*)malloc(sizeof(ntsc_t));
+         if(!slot->kernels) {
+            WARN("Out of memory.");
+            ntscKernels = NULL;
+            return;
+         }
+      }
+
+      // Map from Allegro's 0-63 to the normal 0-255 range, in the order that the display expects.
+      unsigned char colors[PPU__COLOR_MAP_SIZE * 3];
+      for(int i = 0; i < PPU__COLOR_MAP_SIZE; i++) {
+         // For legacy reasons, palette entries are offset by one.
+         const RGB& color = palette[i + 1];
+         const int r = color.r << 2;
+         const int g = color.g << 2;
+         const int b = color.b << 2;
+
+         colors[(i * 3) + 0] = key.swapRGB ? b : r;
+         colors[(i * 3) + 1] = g;
+         colors[(i * 3) + 2] = key.swapRGB ? r : b;
+      }
+
+      // The color controls share the [-1,1] range of the NTSC setup's image parameters.
+      ntsc_setup_t setup = ntsc_composite;
+      setup.hue = key.hue / 100;
+      setup.saturation = key.saturation / 100;
+      setup.brightness = key.brightness / 100;
+      setup.contrast = key.contrast / 100;
+      setup.gamma = key.gamma / 100;
+
+      ntsc_init(slot->kernels, &setup, colors);
+      slot->key = key;
+   }
+
+   slot->lastUsed = ++ntscCacheClock;
+   ntscKernels = slot->kernels;
+}
+
+// Shows a completed frame, which is either the render buffer or one handed over to the presentation thread.
+static void UpdateDisplay(BITMAP* frame)
 {
-   BITMAP* source = Buffers.render;
+   BITMAP* source = frame;
    int sourceWidth = source->w;
    int sourceHeight = source->h;
 
-   if(Output.scale) {
-      /* Allegro's stretch_blit can't convert between different color formats. The best way around this
-         is to blit to a temporary buffer to do so, although that is slow. Oh well. */
-      if(Display.colorDepth != bitmap_color_depth(source)) {
-         BITMAP* buffer = video_get_extra_buffer(sourceWidth, sourceHeight);
-         if(buffer) {
-            blit(source, buffer, 0, 0, 0, 0, sourceWidth, sourceHeight);
-
-            source = buffer;
-            sourceWidth = source->w;
-            sourceHeight = source->h;
-         }
+   /* Find out which lines of the game display have changed since the last frame. If none have, the
+      blitters don't need to be run again, and there's nothing new to put on the screen. */
+   if(FindDirtyLines(source, renderLines) == 0) {
+      UpdateScreen();
+      return;
+   }
+
+   BITMAP* blitted = NULL;
+   switch(Output.blitter) {
+      case VIDEO_BLITTER_HQ2X:
+         blitted = BlitHQX(source, 2);
+         break;
+      case VIDEO_BLITTER_HQ3X:
+         blitted = BlitHQX(source, 3);
+         break;
+      case VIDEO_BLITTER_HQ4X:
+         blitted = BlitHQX(source, 4);
+         break;
+      case VIDEO_BLITTER_NTSC:
+         blitted = BlitNTSC(source);
+         break;
+   }
+
+   if(blitted) {
+      source = blitted;
+      sourceWidth = source->w;
+      sourceHeight = source->h;
+
+      /* The HQX blitters look at the lines above and below each one, so any change spreads to its
+         neighbours. The NTSC blitter changes its burst phase every frame, which affects every line. */
+      const vector<bool> lines = renderLines.lines;
+      const int count = lines.size();
+      for(int line = 0; line < count; line++) {
+         if(Output.blitter == VIDEO_BLITTER_NTSC)
+            renderLines.lines[line] = true;
+         else if(lines[line] || ((line > 0) && lines[line - 1]) || ((line < (count - 1)) && lines[line + 1]))
+            renderLines.lines[line] = true;
       }
+   }
+
+   Output.width = sourceWidth;
+   Output.height = sourceHeight;
 
-      // Calculate the size of the scaled image.
-      const int width = Round(sourceWidth * (Output.scaleWidth / 100));
-      const int height = Round(sourceHeight * (Output.scaleHeight / 100));
+#ifdef USE_ALLEGROGL
+   // OpenGL modes do their own scaling, so the frame is handed over as it is.
+   if(IsOpenGL()) {
+      openGLFrame = source;
+      UpdateScreen();
+      return;
+   }
+#endif
+
+   // Each line of the game display becomes this many lines of the blitter's output.
+   const int factor = MAX(1, sourceHeight / frame->h);
+
+   if(Output.scale) {
+      /* Calculate the size of the scaled image. This is relative to the rendered image rather than the
+         blitter's output, so that e.g HQ2X at 200% ends up being blitted 1:1. */
+      const int width = Round(frame->w * (Output.scaleWidth / 100));
+      const int height = Round(frame->h * (Output.scaleHeight / 100));
 
       // Calculate where to place the scaled image on the screen.
       const int x = (Display.width / 2) - (width / 2);
       const int y = (Display.height / 2) - (height / 2);
 
-      // Scale the image and place it on the screen.
-      acquire_screen();
-      stretch_blit(source, screen, 0, 0, sourceWidth, sourceHeight, x, y, width, height);
-      release_screen();
+      /* Allegro's stretch_blit can't convert between different color formats, so we use our own scaler
+         to do both in a single pass. Dithered conversions are still left up to Allegro. */
+      bool scaled = false;
+      if((Display.colorDepth != bitmap_color_depth(source)) && !Options.enableDither) {
+         acquire_screen();
+
+         scaled = true;
+         int first = 0, last = 0;
+         while(scaled && NextDirtySpan(renderLines, first, last))
+            scaled = ScaleBlitRows(source, screen, x, y, width, height, first * factor, last * factor);
+
+         release_screen();
+      }
+
+      if(!scaled) {
+         /* Otherwise, the best way around this is to blit to a temporary buffer to do the conversion,
+            although that is slow. Oh well. */
+         BITMAP* buffer = NULL;
+         if(Display.colorDepth != bitmap_color_depth(source))
+            buffer = video_get_extra_buffer(sourceWidth, sourceHeight);
+
+         // Scale the changed parts of the image and place them on the screen.
+         acquire_screen();
+
+         int first = 0, last = 0;
+         while(NextDirtySpan(renderLines, first, last)) {
+            const int top = first * factor;
+            const int bottom = last * factor;
+
+            BITMAP* span = source;
+            if(buffer) {
+               blit(source, buffer, 0, top, 0, top, sourceWidth, bottom - top);
+               span = buffer;
+            }
+
+            // Only the lines of the screen which are scaled from these lines of the image are drawn.
+            const int targetTop = ((top * height) + sourceHeight - 1) / sourceHeight;
+            const int targetBottom = ((bottom * height) + sourceHeight - 1) / sourceHeight;
+            if(targetBottom > targetTop) {
+               stretch_blit(span, screen, 0, top, sourceWidth, bottom - top,
+                  x, y + targetTop, width, targetBottom - targetTop);
+            }
+         }
+
+         release_screen();
+      }
    }
    else {
       // Calculate where to place thed image on the screen.
       const int x = (Display.width / 2) - (sourceWidth / 2);
       const int y = (Display.height / 2) - (sourceHeight / 2);
 
-      // Place the image on the screen.
+      // Place the changed parts of the image on the screen.
       acquire_screen();
-      blit(source, screen, 0, 0, 0, 0, sourceWidth, sourceHeight);
+
+      int first = 0, last = 0;
+      while(NextDirtySpan(renderLines, first, last)) {
+         const int top = first * factor;
+         const int bottom = last * factor;
+         blit(source, screen, 0, top, 0, top, sourceWidth, bottom - top);
+      }
+
       release_screen();
    }
 
    UpdateScreen();
 }
 
+// Parameters for running an HQX blitter as a batch of jobs, one band of rows per job.
+typedef struct _VideoHQXJob {
+   BITMAP* source, *output;
+   int scale;
+   int rowsPerBand;
+
+} VideoHQXJob;
+
+/* Runs one of the HQX blitters over the source bitmap, returning the enlarged image, or NULL if the
+   output buffer couldn't be created. The frame is split into horizontal bands that are filtered
+   in parallel on the worker threads. */
+static BITMAP* BlitHQX(BITMAP* source, const int scale)
+{
+   const int width = source->w * scale;
+   const int height = source->h * scale;
+
+   if(Buffers.hqx) {
+      if((Buffers.hqx->w != width) || (Buffers.hqx->h != height))
+         FreeBitmap(Buffers.hqx);
+   }
+
+   if(!Buffers.hqx) {
+      Buffers.hqx = create_bitmap_ex(32, width, height);
+      if(!Buffers.hqx)
+         return NULL;
+   }
+
+   // Use a few bands per thread, so that one thread getting a late start doesn't hold up the others.
+   const int threads = threads_get_count();
+   const int bands = (threads > 1) ? (threads * 2) : 1;
+
+   VideoHQXJob job;
+   job.source = source;
+   job.output = Buffers.hqx;
+   job.scale = scale;
+   job.rowsPerBand = (source->h + bands - 1) / bands;
+
+   threads_run(BlitHQXBand, &job, bands);
+
+   return Buffers.hqx;
+}
+
+static void BlitHQXBand(void* data, const int index)
+{
+   const VideoHQXJob* job = (const VideoHQXJob*)data;
+
+   const int first = index * job->rowsPerBand;
+   int last = first + job->rowsPerBand;
+   if(last > job->source->h)
+      last = job->source->h;
+
+   if(first >= last)
+      return;
+
+   // The HQX code expects both bitmaps to be stored contiguously, which is always true for memory bitmaps.
+   unsigned char* input = (unsigned char*)job->source->line[0];
+   unsigned char* output = (unsigned char*)job->output->line[0];
+   const int width = job->source->w;
+   const int height = job->source->h;
+   const int pitch = job->output->w * 4;
+
+   switch(job->scale) {
+      case 2:
+         hq2x_rows(input, output, width, height, pitch, first, last);
+         break;
+      case 3:
+         hq3x_rows(input, output, width, height, pitch, first, last);
+         break;
+      case 4:
+         hq4x_rows(input, output, width, height, pitch, first, last);
+         break;
+   }
+}
+
+// Parameters for running the NTSC blitter as a batch of jobs, one band of rows per job.
+typedef struct _VideoNTSCJob {
+   BITMAP* source, *output;
+   int burstPhase;
+   int rowsPerBand;
+
+} VideoNTSCJob;
+
+/* Runs the NTSC blitter over the source bitmap, which holds raw PPU output in this mode. Rows are
+   doubled up to keep the aspect ratio. Like the HQX blitters, the frame is split into horizontal
+   bands that are processed in parallel. Returns NULL if the blitter isn't ready. */
+static BITMAP* BlitNTSC(BITMAP* source)
+{
+   if(!ntscKernels)
+      return NULL;
+
+   const int width = NTSC_OUT_WIDTH(source->w);
+   const int height = source->h * 2;
+
+   if(Buffers.ntsc) {
+      if((Buffers.ntsc->w != width) || (Buffers.ntsc->h != height))
+         FreeBitmap(Buffers.ntsc);
+   }
+
+   if(!Buffers.ntsc) {
+      Buffers.ntsc = create_bitmap_ex(32, width, height);
+      if(!Buffers.ntsc)
+         return NULL;
+   }
+
+   // The color burst phase alternates every frame.
+   ntscBurstPhase ^= 1;
+
+   const int threads = threads_get_count();
+   const int bands = (threads > 1) ? (threads * 2) : 1;
+
+   VideoNTSCJob job;
+   job.source = source;
+   job.output = Buffers.ntsc;
+   job.burstPhase = ntscBurstPhase;
+   job.rowsPerBand = (source->h + bands - 1) / bands;
+
+   threads_run(BlitNTSCBand, &job, bands);
+
+   return Buffers.ntsc;
+}
+
+static void BlitNTSCBand(void* data, const int index)
+{
+   const VideoNTSCJob* job = (const VideoNTSCJob*)data;
+
+   const int first = index * job->rowsPerBand;
+   int last = first + job->rowsPerBand;
+   if(last > job->source->h)
+      last = job->source->h;
+
+   if(first >= last)
+      return;
+
+   BITMAP* output = job->output;
+   const long inputPitch = (job->source->line[1] - job->source->line[0]) / sizeof(uint16);
+   const long outputPitch = output->line[1] - output->line[0];
+
+   // The burst phase advances by one every row, so each band has to start from the right one.
+   const int burstPhase = (job->burstPhase + first) % ntsc_burst_count;
+
+   // Draw into the even lines only, then double them up.
+   ntsc_blit(ntscKernels, (const unsigned short*)job->source->line[first], inputPitch, burstPhase,
+      job->source->w, last - first, output->line[first * 2], outputPitch * 2);
+
+   for(int y = first; y < last; y++)
+      memcpy(output->line[(y * 2) + 1], output->line[y * 2], output->w * sizeof(uint32));
+}
+
+static void StartPresentation()
+{
+   // There's no point in a separate thread unless there's a spare processor to run it.
+   if(threads_get_count() < 2)
+      return;
+
+   // OpenGL contexts belong to the thread that created them, so OpenGL modes are always shown directly.
+   if(IsOpenGL())
+      return;
+
+   for(int i = 0; i < PresentFrames; i++) {
+      Buffers.frames[i] = create_bitmap_ex(16, 256, 240);
+      if(!Buffers.frames[i]) {
+         StopPresentation();
+         return;
+      }
+
+      clear_bitmap(Buffers.frames[i]);
+   }
+
+   presentMiddle = 0;
+   presentBack = 1;
+   presentFront = 2;
+
+   presentLock = threads_create_lock();
+   if(!presentLock) {
+      StopPresentation();
+      return;
+   }
+
+   presentThread = threads_start(Present, NULL);
+   if(!presentThread) {
+      StopPresentation();
+      return;
+   }
+
+   log_printf("Frames will be shown on a separate thread.\n");
+}
+
+static void StopPresentation()
+{
+   if(presentThread) {
+      threads_stop(presentThread);
+      presentThread = NULL;
+   }
+
+   if(presentLock) {
+      threads_destroy_lock(presentLock);
+      presentLock = NULL;
+   }
+
+   for(int i = 0; i < PresentFrames; i++)
+      FreeBitmap(Buffers.frames[i]);
+}
+
+// Presentation thread, which shows each frame handed over by video_update_display().
+static void Present(THREAD* thread, void* data)
+{
+   while(!threads_should_stop(thread)) {
+      if(!(presentMiddle & PresentFresh)) {
+         threads_sleep(thread, PresentTimeout);
+         continue;
+      }
+
+      // Swap the latest frame out of the middle slot, giving it the one we showed last.
+      presentFront = threads_exchange(&presentMiddle, presentFront) & ~PresentFresh;
+
+      threads_lock(presentLock);
+
+      // While the GUI is active it is in charge of the screen, so a frame left over from before is dropped.
+      if(!gui_is_active)
+         UpdateDisplay(Buffers.frames[presentFront]);
+
+      threads_unlock(presentLock);
+   }
+}
+
+/* Compares each line of a buffer against the copy that was last shown, flagging the lines that have
+   changed and bringing the copy up to date. Returns the number of changed lines. */
+static int FindDirtyLines(BITMAP* bitmap, VideoDirtyLines& tracker)
+{
+   const int depth = bitmap_color_depth(bitmap);
+
+   BITMAP*& shadow = tracker.shadow;
+   if(shadow) {
+      if((shadow->w != bitmap->w) || (shadow->h != bitmap->h) || (bitmap_color_depth(shadow) != depth))
+         FreeBitmap(shadow);
+   }
+
+   if(!shadow) {
+      shadow = create_bitmap_ex(depth, bitmap->w, bitmap->h);
+      tracker.refresh = true;
+   }
+
+   tracker.lines.resize(bitmap->h);
+
+   // Without anywhere to keep a copy, every line has to be treated as changed.
+   if(!shadow) {
+      tracker.lines.assign(bitmap->h, true);
+      return bitmap->h;
+   }
+
+   const int bytesPerLine = bitmap->w * ((depth + 7) / 8);
+
+   int count = 0;
+   for(int line = 0; line < bitmap->h; line++) {
+      bool changed = tracker.refresh;
+      if(!changed)
+         changed = memcmp(bitmap->line[line], shadow->line[line], bytesPerLine) != 0;
+
+      if(changed) {
+         memcpy(shadow->line[line], bitmap->line[line], bytesPerLine);
+         count++;
+      }
+
+      tracker.lines[line] = changed;
+   }
+
+   tracker.refresh = false;
+   return count;
+}
+
+/* Finds the next run of changed lines, starting from the end of the last one. Start with both 'first'
+   and 'last' set to zero. Returns false when there are no more. */
+static bool NextDirtySpan(const VideoDirtyLines& tracker, int& first, int& last)
+{
+   const int count = tracker.lines.size();
+
+   first = last;
+   while((first < count) && !tracker.lines[first])
+      first++;
+
+   if(first >= count)
+      return false;
+
+   last = first + 1;
+   while((last < count) && tracker.lines[last])
+      last++;
+
+   return true;
+}
+
 static void UpdateScreen()
 {
    // If we're in an OpenGL mode, we'll defer to a dedicated pipeline.
@@ -1725,15 +2556,178 @@ static void UpdateScreen()
    }
 
    if(Display.doubleBuffer) {
+      // Only the lines of the display buffer that have changed since last time need to be shown.
+      if(FindDirtyLines(Buffers.display, displayLines) == 0)
+         return;
+
       acquire_screen();
-      blit(Buffers.display, screen, 0, 0, 0, 0, Buffers.display->w, Buffers.display->h);
+
+      int first = 0, last = 0;
+      while(NextDirtySpan(displayLines, first, last))
+         blit(Buffers.display, screen, 0, first, 0, first, Buffers.display->w, last - first);
+
       release_screen();
    }
 }
 
 static void UpdateScreenOpenGL()
 {
+#ifdef USE_ALLEGROGL
+   // When double buffering (e.g for the GUI), the whole display buffer is shown instead of the game.
+   BITMAP* frame = Display.doubleBuffer ? Buffers.display : openGLFrame;
+   if(!frame || !UploadOpenGLFrame(frame))
+      return;
+
+   // Work out where the frame goes, the same way as UpdateDisplay() does for other modes.
+   int width = frame->w;
+   int height = frame->h;
+   if(!Display.doubleBuffer && Output.scale) {
+      width = Round(Buffers.render->w * (Output.scaleWidth / 100));
+      height = Round(Buffers.render->h * (Output.scaleHeight / 100));
+   }
+
+   const int x = (Display.width / 2) - (width / 2);
+   const int y = (Display.height / 2) - (height / 2);
+
+   // Only recompile the display list when the geometry has changed.
+   if((x != quadX) || (y != quadY) || (width != quadWidth) || (height != quadHeight) ||
+      (frame->w != frameWidth) || (frame->h != frameHeight)) {
+      quadX = x;
+      quadY = y;
+      quadWidth = width;
+      quadHeight = height;
+      frameWidth = frame->w;
+      frameHeight = frame->h;
+
+      const GLfloat u = frameWidth / (GLfloat)textureWidth;
+      const GLfloat v = frameHeight / (GLfloat)textureHeight;
+
+      glNewList(displayList, GL_COMPILE);
+      glBegin(GL_QUADS);
+      glTexCoord2f(0.0, 0.0);
+      glVertex2i(x, y);
+      glTexCoord2f(u, 0.0);
+      glVertex2i(x + width, y);
+      glTexCoord2f(u, v);
+      glVertex2i(x + width, y + height);
+      glTexCoord2f(0.0, v);
+      glVertex2i(x, y + height);
+      glEnd();
+      glEndList();
+   }
+
+   const GLint filter = Options.enableTextureFilter ? GL_LINEAR : GL_NEAREST;
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+
+   glClear(GL_COLOR_BUFFER_BIT);
+   glCallList(displayList);
+
+   allegro_gl_flip();
+#endif
+}
+
+#ifdef USE_ALLEGROGL
+/* Copies a frame into the display texture, (re)allocating the texture if the frame size has changed.
+   Returns false if the frame is in a format that can't be uploaded. */
+static bool UploadOpenGLFrame(BITMAP* frame)
+{
+   const int depth = bitmap_color_depth(frame);
+   const bool swap = video__swap_rgb;
+
+   // Pick an upload format matching Allegro's pixel layout, so that the GL doesn't have to convert.
+   GLenum format, type;
+   int bytesPerPixel;
+   switch(depth) {
+      case 15:
+         format = swap ? GL_RGBA : GL_BGRA;
+         type = GL_UNSIGNED_SHORT_1_5_5_5_REV;
+         bytesPerPixel = 2;
+         break;
+      case 16:
+         format = GL_RGB;
+         type = swap ? GL_UNSIGNED_SHORT_5_6_5_REV : GL_UNSIGNED_SHORT_5_6_5;
+         bytesPerPixel = 2;
+         break;
+      case 24:
+         format = swap ? GL_RGB : GL_BGR;
+         type = GL_UNSIGNED_BYTE;
+         bytesPerPixel = 3;
+         break;
+      case 32:
+         format = swap ? GL_RGBA : GL_BGRA;
+         type = GL_UNSIGNED_BYTE;
+         bytesPerPixel = 4;
+         break;
+
+      default:
+         return false;
+   }
+
+   glBindTexture(GL_TEXTURE_2D, displayTexture);
+
+   if((frame->w > textureWidth) || (frame->h > textureHeight)) {
+      textureWidth = frame->w;
+      textureHeight = frame->h;
+
+      if(!textureAnySize) {
+         int size = 1;
+         while(size < textureWidth)
+            size <<= 1;
+         textureWidth = size;
+
+         size = 1;
+         while(size < textureHeight)
+            size <<= 1;
+         textureHeight = size;
+      }
+
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textureWidth, textureHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+      // Force the display list to be rebuilt, since the texture coordinates have changed.
+      frameWidth = 0;
+      frameHeight = 0;
+   }
+
+   const int rowSize = frame->w * bytesPerPixel;
+   glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+   if(streamAvailable) {
+      streamIndex = (streamIndex + 1) % OpenGLStreamBuffers;
+      glBindBufferPointer(GL_PIXEL_UNPACK_BUFFER_ARB, streamBuffers[streamIndex]);
+
+      /* Respecifying the storage first tells the GL that we don't care about the old contents, so that
+         mapping doesn't have to wait for any pending copy out of this buffer to complete. */
+      glBufferDataPointer(GL_PIXEL_UNPACK_BUFFER_ARB, rowSize * frame->h, NULL, GL_STREAM_DRAW_ARB);
+
+      UINT8* data = (UINT8*)glMapBufferPointer(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+      if(data) {
+         for(int line = 0; line < frame->h; line++) {
+            memcpy(data, frame->line[line], rowSize);
+            data += rowSize;
+         }
+
+         glUnmapBufferPointer(GL_PIXEL_UNPACK_BUFFER_ARB);
+
+         // With a buffer bound, the pointer is an offset into it, and the copy happens asynchronously.
+         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+         glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->w, frame->h, format, type, NULL);
+         glBindBufferPointer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+         return true;
+      }
+
+      // If mapping failed for some reason, fall back to a direct upload.
+      glBindBufferPointer(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+   }
+
+   // Upload straight from the bitmap, which is a synchronous copy.
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, (frame->line[1] - frame->line[0]) / bytesPerPixel);
+   glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, frame->w, frame->h, format, type, frame->line[0]);
+   glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+   return true;
 }
+#endif
 
 static void DrawLightgunCursor()
 {
@@ -1849,7 +2843,15 @@ static void DrawHUD()
 
    video_legacy_shadow_textprintf(buffer, font, left + indent, y, color, opacity,
       "%02d/%g Hz", timing_hertz, (double)timing_get_frame_rate());
-   y += line + 2;
+   y += line;
+
+   if(cpu_get_idle_skipping()) {
+      video_legacy_shadow_textprintf(buffer, font, left + indent, y, color, opacity,
+         "Idle %d cycles", timing_skipped_cycles);
+      y += line;
+   }
+
+   y += 2;
 
    video_legacy_shadow_textprintf(buffer, font, left + indent, y, color, opacity,
       "PC: $%04X", cpu_get_register(CPU_REGISTER_PC));
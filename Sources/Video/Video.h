@@ -93,6 +93,7 @@ enum {
 extern void video_load_config(void);
 extern void video_save_config(void);
 extern int video_init(void);
+extern int video_init_headless(void);
 extern void video_exit(void);
 extern int video_get_profile_integer(const ENUM key);
 extern REAL video_get_profile_real(const ENUM key);
@@ -104,6 +105,8 @@ extern void video_set_profile_enum(const ENUM key, const ENUM value);
 extern void video_set_profile_boolean(const ENUM key, const BOOL value);
 extern void video_update_display(void);
 extern void video_update_game_display(void);
+extern BOOL video_is_threaded(void);
+extern BOOL video_is_busy(void);
 extern void video_update_settings(void);
 extern void video_handle_keypress(const int c, const int scancode);
 extern void video_message(const int duration, const UDATA* message, ...);
@@ -116,6 +119,7 @@ extern BITMAP* video_get_blit_buffer(const int width, const int height);
 extern BITMAP* video_get_extra_buffer(const int width, const int height);
 extern BITMAP* video_get_filter_buffer(const int width, const int height);
 extern BITMAP* video_get_render_buffer(void);
+extern BITMAP* video_copy_render_buffer(void);
 extern int video_legacy_create_color_dither(int r, int g, int b, int x, int y);
 extern int video_legacy_create_gradient(const int start, const int end, const int slices, const int x, const int y);
 extern void video_legacy_create_gui_gradient(GUI_COLOR* start, const GUI_COLOR* end, const int slices);